@@ -0,0 +1,123 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include "workload.hpp"
+
+// 合成基本块负载的生成器，输出可直接作为 DAGOpt 的输入
+// 编译：g++ -std=c++17 -O2 BlockGen.cpp -o BlockGen
+// 运行：./BlockGen out.json [选项]     out.json 为 - 时写到标准输出
+// 选项：
+//   --seed=N          随机种子，默认 1；相同的种子与选项总是生成相同的文件
+//   --blocks=N        块数，默认 1000；为 0 时只受 --bytes 限制
+//   --bytes=N[K|M|G]  写出约 N 字节后停止（按块截断），默认不限
+//   --min-size=N --max-size=N  每块四元式数的范围，默认 4 ~ 32
+//   --log-size        块大小按对数均匀分布（小块多、大块少），默认均匀分布
+//   --vars=N          每块可用的变量数，默认 8
+//   --redundancy=P    重复之前表达式的比例，默认 0.2
+//   --constants=P     操作数为常数的比例，默认 0.3
+//   --arrays=N        数组个数，默认 2
+//   --array-ops=P     数组操作的比例，默认 0.2
+//   --stores=P        数组操作中写数组的比例，默认 0.4
+//   --jumps=P         以条件跳转结尾的块的比例，默认 0.3
+//   --live-out=N      出口活跃变量数的上限，默认 4
+
+
+// 解析带 K/M/G 后缀的字节数
+uint64_t parseBytes(const std::string& text)
+{
+    char* end = nullptr;
+    uint64_t value = std::strtoull(text.c_str(), &end, 10);
+    switch (*end)
+    {
+        case 'K': case 'k':
+            return value << 10;
+        case 'M': case 'm':
+            return value << 20;
+        case 'G': case 'g':
+            return value << 30;
+        default:
+            return value;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: BlockGen out.json [--seed=N] [--blocks=N] [--bytes=N[K|M|G]] ..." << std::endl;
+        return 1;
+    }
+
+    WorkloadSpec spec;
+    size_t blocks = 1000;
+    uint64_t bytes = 0;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+
+        if (key == "--seed")
+            spec.seed = std::stoull(value);
+        else if (key == "--blocks")
+            blocks = std::stoull(value);
+        else if (key == "--bytes")
+            bytes = parseBytes(value);
+        else if (key == "--min-size")
+            spec.minSize = std::stoull(value);
+        else if (key == "--max-size")
+            spec.maxSize = std::stoull(value);
+        else if (key == "--log-size")
+            spec.logSize = true;
+        else if (key == "--vars")
+            spec.vars = std::stoull(value);
+        else if (key == "--redundancy")
+            spec.redundancy = std::stod(value);
+        else if (key == "--constants")
+            spec.constants = std::stod(value);
+        else if (key == "--arrays")
+            spec.arrays = std::stoull(value);
+        else if (key == "--array-ops")
+            spec.arrayOps = std::stod(value);
+        else if (key == "--stores")
+            spec.stores = std::stod(value);
+        else if (key == "--jumps")
+            spec.jumps = std::stod(value);
+        else if (key == "--live-out")
+            spec.liveOut = std::stoull(value);
+        else
+        {
+            std::cerr << "unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    if (spec.minSize == 0)
+        spec.minSize = 1;
+    if (blocks == 0 && bytes == 0)
+    {
+        std::cerr << "either --blocks or --bytes must be non-zero" << std::endl;
+        return 1;
+    }
+
+    std::string path = argv[1];
+    size_t written = 0;
+    if (path == "-")
+        written = writeWorkload(std::cout, spec, blocks, bytes);
+    else
+    {
+        std::ofstream os(path, std::ios::binary);
+        if (!os)
+        {
+            std::cerr << "cannot open " << path << std::endl;
+            return 1;
+        }
+        written = writeWorkload(os, spec, blocks, bytes);
+    }
+
+    std::cerr << written << " blocks written" << std::endl;
+    return 0;
+}
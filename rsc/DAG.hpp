@@ -6,570 +6,754 @@
 #include <assert.h>
 #include "global.hpp"
 #include "convert.hpp"
+#include "arena.hpp"
+#include "symset.hpp"
 
-// DAG结点
-struct DAGNode
+// DAG 的结点以并列数组保存，结点编号即数组下标
+// 遍历只需要结点的值与子结点，二者各自连续存放；标识符表等较少访问的数据放在单独的数组中
+struct NodeKids
 {
-    std::vector<std::string> symList;
     int left = -1;
     int right = -1;
     int tri = -1;
-    std::string value;
+};
 
-    // 对于形如 A [ I ] = X 的操作，其之后需要杀死依赖于 A 的所有结点
-    bool isKilled = false;
+// 优化效果计数，每个基本块 reset() 时清零
+struct OptCounters
+{
+    size_t quadsIn = 0;         // 读入的四元式数
+    size_t quadsOut = 0;        // 生成的四元式数
+    size_t nodesCreated = 0;    // 新建的结点数
+    size_t cseHits = 0;         // 找到已有的同值结点而未新建的次数
+    size_t folds = 0;           // 常数折叠的次数
+    size_t deadRoots = 0;       // 删除的不活跃结点数
+    size_t futileSets = 0;      // 不生成代码的无用赋值数
+    size_t tarKills = 0;        // 被写数组杀死的读数组结点数
+
+    OptCounters& operator+=(const OptCounters& other)
+    {
+        quadsIn += other.quadsIn;
+        quadsOut += other.quadsOut;
+        nodesCreated += other.nodesCreated;
+        cseHits += other.cseHits;
+        folds += other.folds;
+        deadRoots += other.deadRoots;
+        futileSets += other.futileSets;
+        tarKills += other.tarKills;
+        return *this;
+    }
+};
 
-    // 数组操作的还原顺序
-    size_t arrOptSerial = 0xffffffff;
+class DAG
+{
+private:
+    // 结点的值：叶子的值为其操作数，内部结点的值为其运算符
+    std::vector<Operand> nodeValue;
+    std::vector<NodeKids> nodeKids;
 
-    static std::shared_ptr<DAGNode> createNode()
+    // 结点状态及生成代码前为每个结点预先计算的属性
+    enum NodeFlag : uint8_t
     {
-        auto newNode = std::make_shared<DAGNode>();
-        return newNode;
-    }
+        NODE_ROOT = 1,
+        NODE_ACTIVE = 2,
+        NODE_FUTILE = 4,
+        NODE_DEAD = 8,
+        NODE_KEPT = 16      // 没有活跃的标识符也要生成代码，如改为赋给临时变量的结点
+    };
+    std::vector<uint8_t> nodeFlags;
+
+    // 读数组结点创建时该数组的写入代数
+    // 对于形如 A [ I ] = X 的操作，其之后读 A 的所有结点失效，即代数不再相等
+    std::vector<uint32_t> nodeEpoch;
+
+    // 各结点的附加标识符，绝大多数结点只有 0 ~ 2 个，前 3 个直接存放在元素内
+    std::vector<SmallVector<uint32_t, 3>> nodeSyms;
+
+    // 数组操作必须排在其后的同一数组上的先前操作：
+    // 读依赖于最近一次写，写依赖于最近一次写及其后的所有读
+    std::vector<SmallVector<int, 2>> nodeMemDeps;
+
+    // 当前基本块的结点数，各数组超出这一长度的元素留给后续基本块复用
+    size_t nodeCount{};
+
+    // 本基本块中出现的所有名字与常数
+    SymbolTable syms;
+
+    // 常数叶子的按值索引：常数操作数 -> 叶子的编号
+    FlatMap literalLeaves;
+
+    // 查找方式：四元式数不少于 indexThreshold 的基本块使用下面的索引，
+    // 较小的基本块直接线性扫描所有结点，省去维护索引的开销
+    size_t indexThreshold = DefaultIndexThreshold;
+    bool indexed = false;
+
+    // 名字 -> 带有该标识符的结点，仅 indexed 时维护
+    std::vector<SmallVector<int, 1>> symbolOwners;
+    size_t symbolOwnersUsed{};
+
+    // (值, 子结点) -> 最近创建的该值结点的开放寻址哈希表，保存 编号 + 1，0 表示空槽，仅 indexed 时维护
+    // 同一键至多只有最近创建的结点未被杀死，因此只需保存最近的一个
+    std::vector<int> valueSlots;
+    size_t valueCount{};
+
+    // readQuad 返回的新建结点编号，跨基本块复用其容量
+    std::vector<size_t> newNodes;
 
-    void removeSymbol(const std::string& target)
+    // genOptimizedCode 返回的优化后代码，跨基本块复用其容量
+    std::vector<QuadExp> optimizedCode;
+
+    // 生成代码前预先计算的各结点作为操作数时输出的名字，跨基本块复用其容量
+    std::vector<Operand> nodeNames;
+
+    // 删除无用结点后是否将剩余结点重新连续编号
+    bool compaction = true;
+
+    // 重新编号后各结点原来的编号，仅用于打印 DAG；未重新编号时为空
+    std::vector<int> originalIndex;
+
+    // 出口活跃变量集合，genOptimizedCode 期间有效
+    SymbolBitset liveOut;
+
+    // 生成代码时的所有临时容器均从该分配器分配，reset() 时一次性回收
+    BlockArena arena;
+
+    // 强制跳转和停机语句不生成DAG，仅暂存
+    QuadExp jumperRec;
+    QuadExp haltRec;
+
+    OptCounters stats;
+
+    // 各数组的访存链：最近一次写及其后的所有读（结点编号）
+    struct ArrayChain
+    {
+        uint32_t epoch = 0;     // 已写入的次数
+        int lastStore = -1;
+        std::vector<int> loads;
+    };
+
+    // 数组名 -> arrayChains 中的下标，链跨基本块复用
+    FlatMap arrayChainIndex;
+    std::vector<ArrayChain> arrayChains;
+    size_t chainsUsed{};
+
+    // 新建值为 v、子结点为 l, r, t 的结点，返回其编号
+    int createNode(const Operand& v, int l = -1, int r = -1, int t = -1)
     {
-        for (auto it = symList.begin(); it != symList.end(); )
+        if (nodeCount == nodeValue.size())
         {
-            if (*it == target)
-                it = symList.erase(it);
-            else
-                ++it;
+            nodeValue.emplace_back();
+            nodeKids.emplace_back();
+            nodeFlags.emplace_back();
+            nodeEpoch.emplace_back();
+            nodeSyms.emplace_back();
+            nodeMemDeps.emplace_back();
         }
+
+        int n = int(nodeCount++);
+        ++stats.nodesCreated;
+        nodeValue[n] = v;
+        nodeKids[n] = NodeKids{ l, r, t };
+        nodeFlags[n] = 0;
+        nodeEpoch[n] = 0;
+        nodeSyms[n].clear();
+        nodeMemDeps[n].clear();
+
+        if (indexed)
+            indexNode(n);
+        return n;
     }
 
-    void addSymbol(const std::string& target)
+    static size_t valueHash(const Operand& v, int l, int r, int t)
     {
-        if (contain(symList, target))
-            return;
-        symList.emplace_back(target);
+        uint64_t k = (uint64_t(v.kind) << 32 | v.id) * 0x9e3779b97f4a7c15ull;
+        k ^= uint64_t(uint32_t(l)) * 0xbf58476d1ce4e5b9ull;
+        k ^= uint64_t(uint32_t(r)) * 0x94d049bb133111ebull;
+        k ^= uint64_t(uint32_t(t)) * 0xd6e8feb86659fd93ull;
+        return size_t(k ^ (k >> 29));
     }
 
-    bool isLeaf()
+    bool sameValue(int n, const Operand& v, int l, int r, int t) const
     {
-        return (left == -1 && right == -1 && tri == -1);
+        const NodeKids& k = nodeKids[n];
+        return nodeValue[n] == v && k.left == l && k.right == r && k.tri == t;
     }
 
-};
-
-class DAG
-{
-private:
-    std::vector<std::shared_ptr<DAGNode>> nodes;
+    // 将结点 n 登记到按值索引中，取代同一键下之前的结点
+    void indexNode(int n)
+    {
+        if ((valueCount + 1) * 2 > valueSlots.size())
+        {
+            std::vector<int> old;
+            old.swap(valueSlots);
+            valueSlots.assign(old.empty() ? 64 : old.size() * 2, 0);
+            valueCount = 0;
+            for (auto&& slot : old)
+                if (slot != 0)
+                    indexNode(slot - 1);
+        }
 
-    // 强制跳转和停机语句不生成DAG，仅暂存
-    QuadExp jumperRec;
-    QuadExp haltRec;
+        const NodeKids& k = nodeKids[n];
+        size_t mask = valueSlots.size() - 1;
+        size_t i = valueHash(nodeValue[n], k.left, k.right, k.tri) & mask;
+        while (valueSlots[i] != 0 && !sameValue(valueSlots[i] - 1, nodeValue[n], k.left, k.right, k.tri))
+            i = (i + 1) & mask;
 
-    // 数组元素的还原顺序
-    size_t arrOptSerial{};
+        if (valueSlots[i] == 0)
+            ++valueCount;
+        valueSlots[i] = n + 1;
+    }
 
-    // 返回结点 target 在 DAG 中的索引
-    int findNode(std::shared_ptr<DAGNode> target) const
+    // 在按值索引中查找结点，不存在时返回 -1
+    int findIndexedNode(const Operand& v, int l, int r, int t) const
     {
-        for (size_t i = 0; i < nodes.size(); ++i)
+        if (valueSlots.empty())
+            return -1;
+
+        size_t mask = valueSlots.size() - 1;
+        for (size_t i = valueHash(v, l, r, t) & mask; valueSlots[i] != 0; i = (i + 1) & mask)
         {
-            if (nodes[i] == target)
-                return i;
+            if (sameValue(valueSlots[i] - 1, v, l, r, t))
+                return valueSlots[i] - 1;
         }
         return -1;
     }
 
-    // 通过 Symbol 查找结点
-    std::shared_ptr<DAGNode> findNodeBySymbol(const std::string& target) const
+    bool isLeaf(int n) const
+    {
+        const NodeKids& k = nodeKids[n];
+        return (k.left == -1 && k.right == -1 && k.tri == -1);
+    }
+
+    bool isOp(int n, uint8_t op) const
+    {
+        return nodeValue[n] == Operand::op(op);
+    }
+
+    bool isDead(int n) const
+    {
+        return nodeFlags[n] & NODE_DEAD;
+    }
+
+    void addSymbol(int n, uint32_t target)
+    {
+        if (contain(nodeSyms[n], target))
+            return;
+        nodeSyms[n].emplace_back(target);
+
+        if (indexed)
+        {
+            if (target >= symbolOwners.size())
+                symbolOwners.resize(std::max<size_t>(target + 1, syms.size()));
+            symbolOwnersUsed = std::max<size_t>(symbolOwnersUsed, target + 1);
+            symbolOwners[target].emplace_back(n);
+        }
+    }
+
+    // 返回数组 array 的访存链
+    // 数组按输出的名字区分：基址结点只是数组名的叶子，同名变量的赋值（如 B = A）不影响数组
+    ArrayChain& arrayChain(const Operand& array)
+    {
+        uint64_t key = (uint64_t(array.kind) << 32) | array.id;
+        int k = arrayChainIndex.find(key);
+        if (k != -1)
+            return arrayChains[k];
+
+        if (chainsUsed == arrayChains.size())
+            arrayChains.emplace_back();
+        ArrayChain& chain = arrayChains[chainsUsed];
+        chain.epoch = 0;
+        chain.lastStore = -1;
+        chain.loads.clear();
+        arrayChainIndex.insert(key, int(chainsUsed++));
+        return chain;
+    }
+
+    // 将结点 index 记为对数组 array 的一次读
+    void recordLoad(const Operand& array, int index)
+    {
+        ArrayChain& chain = arrayChain(array);
+        if (chain.lastStore != -1)
+            nodeMemDeps[index].emplace_back(chain.lastStore);
+        chain.loads.emplace_back(index);
+    }
+
+    // 将结点 index 记为对数组 array 的一次写
+    void recordStore(const Operand& array, int index)
+    {
+        ArrayChain& chain = arrayChain(array);
+        auto& deps = nodeMemDeps[index];
+        if (chain.lastStore != -1)
+            deps.emplace_back(chain.lastStore);
+        for (auto&& load : chain.loads)
+            deps.emplace_back(load);
+        chain.lastStore = index;
+        stats.tarKills += chain.loads.size();
+        chain.loads.clear();
+        ++chain.epoch;
+    }
+
+    // 返回数组 array 当前的写入代数
+    uint32_t storeEpoch(const Operand& array) const
+    {
+        int k = arrayChainIndex.find((uint64_t(array.kind) << 32) | array.id);
+        return k == -1 ? 0 : arrayChains[k].epoch;
+    }
+
+    // 判断结点 n 是否已被之后对同一数组的写入杀死，只有读数组结点会被杀死
+    bool isKilled(int n) const
+    {
+        return isOp(n, OP_FAR) && nodeEpoch[n] != storeEpoch(nodeValue[nodeKids[n].left]);
+    }
+
+    // 通过 Symbol 查找结点，只有名字才可能是 Symbol
+    int findNodeBySymbol(const Operand& target) const
     {
-        for (auto&& node : nodes)
+        if (target.kind != OPD_NAME)
+            return -1;
+
+        //带有同一标识符的结点可能不止一个（被杀死的结点保留了标识符），取编号最小的
+        if (indexed)
         {
-            if (node == nullptr)
+            if (target.id >= symbolOwners.size() || symbolOwners[target.id].empty())
+                return -1;
+            int first = -1;
+            for (auto&& n : symbolOwners[target.id])
+                if (!isDead(n) && (first == -1 || n < first))
+                    first = n;
+            return first;
+        }
+
+        for (size_t n = 0; n < nodeCount; ++n)
+        {
+            if (isDead(n))
                 continue;
-            for (auto&& symbol : node->symList)
+            for (auto&& symbol : nodeSyms[n])
             {
-                if (symbol == target)
-                    return node;
+                if (symbol == target.id)
+                    return int(n);
             }
         }
-        return nullptr;
+        return -1;
     }
 
-    // 通过 value 及子结点来查找结点
-    std::shared_ptr<DAGNode> findNodeByValue(const std::string& target, int l, int r, int t) const
+    // 通过 value 及子结点来查找结点，已被杀死的结点不参与查找
+    int findNodeByValue(const Operand& target, int l, int r, int t) const
     {
-        for (auto&& node : nodes)
+        if (indexed)
         {
-            if (node == nullptr)
+            int n = findIndexedNode(target, l, r, t);
+            return (n == -1 || isDead(n) || isKilled(n)) ? -1 : n;
+        }
+
+        for (size_t n = 0; n < nodeCount; ++n)
+        {
+            if (isDead(n) || isKilled(n))
                 continue;
-            if (node->value == target && node->left == l && node->right == r && node->tri == t)
-                return node;
+            const NodeKids& k = nodeKids[n];
+            if (nodeValue[n] == target && k.left == l && k.right == r && k.tri == t)
+                return int(n);
         }
-        return nullptr;
+        return -1;
+    }
+
+    // 查找值为 v 的叶子，常数叶子按值哈希查找
+    int findLeaf(const Operand& v) const
+    {
+        if (isLiteral(v))
+            return literalLeaves.find(literalKey(v));
+        return findNodeByValue(v, -1, -1, -1);
+    }
+
+    // 新建值为 v 的叶子并加入 DAG
+    int createLeaf(const Operand& v)
+    {
+        int n = createNode(v);
+        newNodes.emplace_back(n);
+
+        if (isLiteral(v))
+            literalLeaves.insert(literalKey(v), n);
+        return n;
+    }
+
+    // 查找值为 v 的叶子，不存在时新建
+    int findOrCreateLeaf(const Operand& v)
+    {
+        int n = findLeaf(v);
+        return n == -1 ? createLeaf(v) : n;
+    }
+
+    static uint64_t literalKey(const Operand& v)
+    {
+        return (uint64_t(v.kind) << 32) | v.id;
     }
 
     // 判断带有附加标识符 symbol 的结点是否表示一个字面常量
-    bool isLiteralNode(const std::string& symbol) const
+    bool isLiteralNode(const Operand& symbol) const
     {
-        auto n = findNodeBySymbol(symbol);
-        if (!n)
+        int n = findNodeBySymbol(symbol);
+        if (n == -1)
             return false;
-        if (n->left != -1 && n->right == -1 && n->tri == -1 && isLiteral(nodes[n->left]->value))
+        const NodeKids& k = nodeKids[n];
+        if (k.left != -1 && k.right == -1 && k.tri == -1 && isLiteral(nodeValue[k.left]))
             return true;
-        if (n->right != -1 && n->left == -1 && n->tri == -1 && isLiteral(nodes[n->right]->value))
+        if (k.right != -1 && k.left == -1 && k.tri == -1 && isLiteral(nodeValue[k.right]))
             return true;
         return false;
     }
 
     // 取得一个字面常量结点所表示的常量值
-    int getLiteral(const std::string& symbol) const
+    int64_t getLiteral(const Operand& symbol) const
     {
         if (isLiteral(symbol))
-            return std::stoi(symbol);
+            return literalValue(symbol);
 
-        auto n = findNodeBySymbol(symbol);
-        assert(n != nullptr);
+        int n = findNodeBySymbol(symbol);
+        assert(n != -1);
 
-        if (n->left != -1)
-            return std::stoi(nodes[n->left]->value);
+        if (nodeKids[n].left != -1)
+            return literalValue(nodeValue[nodeKids[n].left]);
         else
-            return -std::stoi(nodes[n->right]->value);
+            return -literalValue(nodeValue[nodeKids[n].right]);
 
     }
 
-    // 删除 DAG 上所有等于 target 的附加标识符
-    void removeSymbol(const std::string& target)
+    // 返回常数操作数的值
+    int64_t literalValue(const Operand& arg) const
     {
-        for (auto&& node : nodes)
+        if (arg.kind == OPD_IMM)
+            return int64_t(arg.id);
+        return syms.literal(arg.id);
+    }
+
+    // 计算常数运算 v2 op v3 的值
+    // 非算术运算、除数为零或结果溢出时不折叠，返回 false
+    static bool foldConstant(uint8_t op, int64_t v2, int64_t v3, int64_t& val)
+    {
+        switch (op)
         {
-            if (node != nullptr)
-                node->removeSymbol(target);
+            case OP_ADD:
+                return !__builtin_add_overflow(v2, v3, &val);
+            case OP_SUB:
+                return !__builtin_sub_overflow(v2, v3, &val);
+            case OP_MUL:
+                return !__builtin_mul_overflow(v2, v3, &val);
+            case OP_DIV:
+            case OP_MOD:
+                if (v3 == 0 || (v2 == INT64_MIN && v3 == -1))
+                    return false;
+                val = (op == OP_DIV ? v2 / v3 : v2 % v3);
+                return true;
+            default:
+                return false;
         }
     }
 
-    // 查找 DAG 上所有依赖于 n 的结点
-    std::vector<size_t> findNodesDependingOn(std::shared_ptr<DAGNode> n)
+    // 删除 DAG 上所有等于 target 的附加标识符
+    void removeSymbol(const Operand& target)
     {
-        std::vector<size_t> result;
-        int index = findNode(n);
+        if (target.kind != OPD_NAME)
+            return;
 
-        for (size_t i = 0; i < nodes.size(); ++i)
+        auto removeFrom = [&](size_t n)
         {
-            if (nodes[i]->left == index || nodes[i]->right == index || nodes[i]->tri == index)
-                result.emplace_back(i);
+            auto& symList = nodeSyms[n];
+            for (auto it = symList.begin(); it != symList.end(); )
+            {
+                if (*it == target.id)
+                    it = symList.erase(it);
+                else
+                    ++it;
+            }
+        };
+
+        if (indexed)
+        {
+            if (target.id < symbolOwners.size())
+            {
+                for (auto&& n : symbolOwners[target.id])
+                    removeFrom(n);
+                symbolOwners[target.id].clear();
+            }
+            return;
         }
 
-        return result;
+        for (size_t n = 0; n < nodeCount; ++n)
+            removeFrom(n);
     }
 
     // 读取四元式
     // (op, a1, a2, -)
-    std::vector<size_t> readQuad0(const QuadExp& E)
+    const std::vector<size_t>& readQuad0(const QuadExp& E)
     {
-        std::vector<size_t> result;
-        std::shared_ptr<DAGNode> n1 = nullptr, n2 = nullptr;
-        auto n = findNodeBySymbol(E.a1);
-        if (n != nullptr && !n->isKilled)
+        auto& result = newNodes;
+        result.clear();
+        int n1 = -1, n2 = -1;
+        // 先取 a2 当前所在的结点再删除 a1，a1 与 a2 相同时仍指向原结点；
+        // 被写数组杀死的结点不能再被公共子表达式复用，但其标识符仍持有读出的值
+        n2 = findNodeBySymbol(E.operand(2));
+        removeSymbol(E.operand(1));
+
+        if (n2 != -1)   // a2作为内部变量（可能活跃）出现过
         {
-            removeSymbol(E.a1);
-        }
-
-        n2 = findNodeBySymbol(E.a2);
-        if (n2 != nullptr && !n2->isKilled)   // a2作为内部变量（可能活跃）出现过
-        {
-            n2->addSymbol(E.a1);
+            addSymbol(n2, E.a1);
         }
         else                // a2没有作为内部变量出现过，还可能作为外部变量（叶子）出现过
         {
-            n2 = findNodeByValue(E.a2, -1, -1, -1);
-            if (n2 == nullptr)   //不存在n2 创建
-            {
-                n2 = DAGNode::createNode();
-                n2->left = -1, n2->right = -1, n2->tri = -1;
-                n2->value = E.a2;
-                nodes.emplace_back(n2);
-                result.emplace_back(nodes.size() - 1);
+            n2 = findOrCreateLeaf(E.operand(2));
+            n1 = findNodeByValue(Operand::op(E.op), n2, -1, -1);
 
-            }
-
-            int indexn2 = findNode(n2);
-            n1 = findNodeByValue(E.op, indexn2, -1, -1);
-
-            if (n1 != nullptr && !n1->isKilled)   // 已经存在 b = CONST这样的赋值，则直接附上a1
+            if (n1 != -1)   // 已经存在 b = CONST这样的赋值，则直接附上a1
             {
-                n1->addSymbol(E.a1);
+                ++stats.cseHits;
+                addSymbol(n1, E.a1);
             }
             else                //若不存在，创建a1
             {
-                n1 = DAGNode::createNode();
-                n1->left = indexn2, n1->right = -1, n1->tri = -1;
-                n1->value = E.op;
-                n1->addSymbol(E.a1);
-                nodes.emplace_back(n1);
-                result.emplace_back(nodes.size() - 1);
+                n1 = createNode(Operand::op(E.op), n2);
+                addSymbol(n1, E.a1);
+                result.emplace_back(n1);
             }
         }
         return result;
     }
     // (op, a1, a2, a3)
-    std::vector<size_t> readQuad2(const QuadExp& E)
+    const std::vector<size_t>& readQuad2(const QuadExp& E)
     {
-        std::vector<size_t> result;
-        std::shared_ptr<DAGNode> n1 = nullptr, n2 = nullptr, n3 = nullptr;
+        auto& result = newNodes;
+        result.clear();
+        int n1 = -1, n2 = -1, n3 = -1;
         bool n2Literal = false, n3Literal = false;
-        int indexn2 = -1, indexn3 = -1;
 
-        if (isLiteral(E.a2) || isLiteralNode(E.a2))
+        if (isLiteral(E.operand(2)) || isLiteralNode(E.operand(2)))
             n2Literal = true;
-        if (isLiteral(E.a3) || isLiteralNode(E.a3))
+        if (isLiteral(E.operand(3)) || isLiteralNode(E.operand(3)))
             n3Literal = true;
 
-        if (findNodeBySymbol(E.a2) != nullptr)
+        if (findNodeBySymbol(E.operand(2)) != -1)
             n2Literal = false;
-        if (findNodeBySymbol(E.a3) != nullptr)
+        if (findNodeBySymbol(E.operand(3)) != -1)
             n3Literal = false;
 
-        //n2和n3均为值是常量的叶子结点，则直接计算n1
-        if (n2Literal && n3Literal)
+        //n2和n3均为值是常量的叶子结点，且运算可以在编译期完成，则直接计算n1
+        int64_t val = 0;
+        if (n2Literal && n3Literal && foldConstant(E.op, getLiteral(E.operand(2)), getLiteral(E.operand(3)), val))
         {
-            int val = 0, val2, val3;
-            val2 = getLiteral(E.a2);
-            val3 = getLiteral(E.a3);
-
-            if (E.op == "ADD")
-                val = val2 + val3;
-            else if (E.op == "SUB")
-                val = val2 - val3;
-            else if (E.op == "MUL")
-                val = val2 * val3;
-            else if (E.op == "DIV")
-                val = val2 / val3;
-            else if (E.op == "MOD")
-                val = val2 % val3;
-
-
             //已经存在值为val2 op val3的常量叶子，则a1 = val2 op val3
             //否则创建一个val2 op val3的常量叶子
+            ++stats.folds;
+            int n = findOrCreateLeaf(makeLiteral(val, syms));
+            n1 = findNodeByValue(Operand::op(OP_SET), n, -1, -1);
 
-            std::shared_ptr<DAGNode> n = findNodeByValue(std::to_string(val), -1, -1, -1);
-            if (n == nullptr)
+            if (n1 != -1)
             {
-                n = DAGNode::createNode();
-                n->value = std::to_string(val);
-                n->left = -1, n->right = -1, n->tri = -1;
-                nodes.emplace_back(n);
-                result.emplace_back(nodes.size() - 1);
-            }
-
-            n1 = findNodeByValue("SET", findNode(n), -1, -1);
-
-
-            if (n1 != nullptr && !n1->isKilled)
-            {
-                removeSymbol(E.a1);
-                n1->addSymbol(E.a1);
+                ++stats.cseHits;
+                removeSymbol(E.operand(1));
+                addSymbol(n1, E.a1);
             }
             else
             {
-                n1 = DAGNode::createNode();
-                n1->left = findNode(n), n->right = -1, n->tri = -1;
-                n1->value = "SET";
-                removeSymbol(E.a1);
-                n1->addSymbol(E.a1);
-                nodes.emplace_back(n1);
-                result.emplace_back(nodes.size() - 1);
+                n1 = createNode(Operand::op(OP_SET), n);
+                removeSymbol(E.operand(1));
+                addSymbol(n1, E.a1);
+                result.emplace_back(n1);
             }
         }
         //n2和n3至少一个不是常量叶子（内部变量或外部变量）
         else
         {
-            n2 = findNodeBySymbol(E.a2);
-            if (n2 == nullptr)
-            {
-                n2 = findNodeByValue(E.a2, -1, -1, -1);
-                if (n2 == nullptr)   // a2不存在, 说明a2是一个外部变量, 创建一个叶子表示它
-                {
-                    n2 = DAGNode::createNode();
-                    n2->left = -1, n2->right = -1, n2->tri = -1;
-                    n2->value = E.a2;
-                    nodes.emplace_back(n2);
-                    result.emplace_back(nodes.size() - 1);
-                }
-            }
-
-            n3 = findNodeBySymbol(E.a3);
-            if (n3 == nullptr)
+            // a2, a3 不存在, 说明是外部变量, 创建叶子表示它们
+            // 数组按名字区分，读数组的基址总是数组名的叶子，而不是同名变量当前所在的结点
+            if (E.op != OP_FAR)
+                n2 = findNodeBySymbol(E.operand(2));
+            if (n2 == -1)
+                n2 = findOrCreateLeaf(E.operand(2));
+
+            n3 = findNodeBySymbol(E.operand(3));
+            if (n3 == -1)
+                n3 = findOrCreateLeaf(E.operand(3));
+
+            n1 = findNodeByValue(Operand::op(E.op), n2, n3, -1);
+            if (n1 != -1)
             {
-                n3 = findNodeByValue(E.a3, -1, -1, -1);
-                if (n3 == nullptr)   // a3不存在, 说明a3是一个外部变量, 创建一个叶子表示它
-                {
-                    n3 = DAGNode::createNode();
-                    n3->left = -1, n3->right = -1, n3->tri = -1;
-                    n3->value = E.a3;
-                    nodes.emplace_back(n3);
-                    result.emplace_back(nodes.size() - 1);
-                }
-            }
-
-            indexn2 = findNode(n2);
-            indexn3 = findNode(n3);
-            n1 = findNodeByValue(E.op, indexn2, indexn3, -1);
-            if (n1 != nullptr && !n1->isKilled)
-            {
-                removeSymbol(E.a1);
-                n1->addSymbol(E.a1);
+                ++stats.cseHits;
+                removeSymbol(E.operand(1));
+                addSymbol(n1, E.a1);
             }
             else
             {
-                n1 = DAGNode::createNode();
-                n1->left = indexn2, n1->right = indexn3, n1->tri = -1;
-                n1->value = E.op;
+                n1 = createNode(Operand::op(E.op), n2, n3);
+                if (E.op == OP_FAR)
+                    nodeEpoch[n1] = storeEpoch(E.operand(2));
 
-                if (E.op == "FAR")
-                    n1->arrOptSerial = (this->arrOptSerial)++;
+                removeSymbol(E.operand(1));
+                addSymbol(n1, E.a1);
+                result.emplace_back(n1);
 
-                removeSymbol(E.a1);
-                n1->addSymbol(E.a1);
-                nodes.emplace_back(n1);
-                result.emplace_back(nodes.size() - 1);
+                if (E.op == OP_FAR)
+                    recordLoad(E.operand(2), n1);
             }
         }
         return result;
     }
     // (TAR, a1, a2, a3)  a1[a2] = a3
-    std::vector<size_t> readQuad3(const QuadExp& E)
+    const std::vector<size_t>& readQuad3(const QuadExp& E)
     {
-        std::vector<size_t> result;
-        std::shared_ptr<DAGNode> n1 = nullptr, n2 = nullptr, n3 = nullptr, n = nullptr;
-        n1 = findNodeBySymbol(E.a1);
-        n2 = findNodeBySymbol(E.a2);
-        n3 = findNodeBySymbol(E.a3);
+        auto& result = newNodes;
+        result.clear();
+        // 写数组的基址同样总是数组名的叶子
+        int n1 = findOrCreateLeaf(E.operand(1));
+        int n2 = findNodeBySymbol(E.operand(2));
+        int n3 = findNodeBySymbol(E.operand(3));
 
-        if (n1 == nullptr)
-        {
-            n1 = findNodeByValue(E.a1, -1, -1, -1);
-            if (n1 == nullptr)
-            {
-                n1 = DAGNode::createNode();
-                n1->left = -1, n1->right = -1, n1->tri = -1;
-                n1->value = E.a1;
-                nodes.emplace_back(n1);
-                result.emplace_back(nodes.size() - 1);
-            }
-        }
+        if (n2 == -1)
+            n2 = findOrCreateLeaf(E.operand(2));
+        if (n3 == -1)
+            n3 = findOrCreateLeaf(E.operand(3));
 
-        if (n2 == nullptr)
-        {
-            n2 = findNodeByValue(E.a2, -1, -1, -1);
-            if (n2 == nullptr)
-            {
-                n2 = DAGNode::createNode();
-                n2->left = -1, n2->right = -1, n2->tri = -1;
-                n2->value = E.a2;
-                nodes.emplace_back(n2);
-                result.emplace_back(nodes.size() - 1);
-            }
-        }
+        int n = createNode(Operand::op(E.op), n1, n2, n3);
 
-        if (n3 == nullptr)
-        {
-            n3 = findNodeByValue(E.a3, -1, -1, -1);
-            if (n3 == nullptr)
-            {
-                n3 = DAGNode::createNode();
-                n3->left = -1, n3->right = -1, n3->tri = -1;
-                n3->value = E.a3;
-                nodes.emplace_back(n3);
-                result.emplace_back(nodes.size() - 1);
-            }
-        }
-
-        n = DAGNode::createNode();
-        n->left = findNode(n1), n->right = findNode(n2), n->tri = findNode(n3);
-        n->value = E.op;
-
-        if (E.op == "TAR")
-            n->arrOptSerial = (this->arrOptSerial)++;
-
-        nodes.emplace_back(n);
-        result.emplace_back(nodes.size() - 1);
-
-        [=]() -> void
-        {
-            int index = findNode(n1);
-            for (auto&& node : nodes)
-                if (node->left == index)
-                    node->isKilled = true;
-            
-        }();
+        result.emplace_back(n);
+        //写入使 A 的代数加一，之前读 A 的所有结点随之失效，同名变量的运算不受影响
+        recordStore(E.operand(1), n);
 
         return result;
     }
 
-    // 判断结点 n 是否是入度为 0 的结点
-    bool isRoot(std::shared_ptr<DAGNode> n) const
+    // 删除已删除的结点并将剩余结点按原顺序重新编号，同步更新子结点、访存依赖
+    // 及按结点编号的数组 parents，返回剩余结点数
+    // 重新编号后各按编号的查找表失效，DAG 只能在 reset() 后继续读入四元式
+    size_t compactNodes(std::pmr::vector<int>& parents)
     {
-        if (n == nullptr)
-            return false;
-        for (auto&& node : nodes)
+        std::pmr::vector<int> newIndex(nodeCount, -1, arena.resource());
+        originalIndex.clear();
+
+        size_t k = 0;
+        for (size_t n = 0; n < nodeCount; ++n)
         {
-            if (node == nullptr)
+            if (isDead(n))
                 continue;
-            if (
-                (node->left != -1 && nodes[node->left] == n) ||
-                (node->right != -1 && nodes[node->right] == n) ||
-                (node->tri != -1 && nodes[node->tri] == n)
-                )
+            newIndex[n] = int(k);
+            if (k != n)
             {
-                return false;
+                nodeValue[k] = nodeValue[n];
+                nodeKids[k] = nodeKids[n];
+                nodeFlags[k] = nodeFlags[n];
+                nodeEpoch[k] = nodeEpoch[n];
+                nodeSyms[k] = nodeSyms[n];
+                nodeMemDeps[k] = nodeMemDeps[n];
+                parents[k] = parents[n];
             }
+            originalIndex.emplace_back(int(n));
+            ++k;
         }
-        return true;
+        nodeCount = k;
+        parents.resize(k);
+
+        for (size_t n = 0; n < nodeCount; ++n)
+        {
+            NodeKids& kids = nodeKids[n];
+            if (kids.left != -1)
+                kids.left = newIndex[kids.left];
+            if (kids.right != -1)
+                kids.right = newIndex[kids.right];
+            if (kids.tri != -1)
+                kids.tri = newIndex[kids.tri];
+
+            //被删除的读不再约束之后的写
+            auto& deps = nodeMemDeps[n];
+            for (auto it = deps.begin(); it != deps.end(); )
+            {
+                *it = newIndex[*it];
+                if (*it == -1)
+                    it = deps.erase(it);
+                else
+                    ++it;
+            }
+        }
+        return k;
     }
 
     // 判断结点 n 是否是有活跃变量的结点
-    bool isActiveNode(std::shared_ptr<DAGNode> n, const std::vector<std::string>& outActive) const
+    bool isActiveNode(int n) const
     {
-        if (n == nullptr)
-            return false;
-
-        if (n->isLeaf())
+        if (isLeaf(n))
             return false;
 
-        if (n->value == "TAR")
+        if (isOp(n, OP_TAR))
             return true;
 
-        if (n->value[0] == 'J' && n->value != "JMP")
+        if (nodeValue[n].kind == OPD_OP && isConditionalJump(nodeValue[n].id))
             return true;
 
-        for (auto&& sym : n->symList)
-        {
-            if (contain(outActive, sym))
-                return true;
-        }
-
-        return false;
+        return anyIn(nodeSyms[n], liveOut);
     }
 
-    // 返回一个结点 n 生成的所有代码
-    std::vector<QuadExp> genCode(std::shared_ptr<DAGNode> n, const std::vector<std::string>& outActive) const
+    // 将结点 n 生成的所有代码追加到 result 末尾
+    // 操作数的名字取自 genOptimizedCode 预先计算的 nodeNames
+    void genCode(int n, std::vector<QuadExp>& result)
     {
-        std::vector<QuadExp> result;
-        if (n == nullptr)
-            return result;
+        const NodeKids& k = nodeKids[n];
+        const auto& symList = nodeSyms[n];
 
-        if (n->value == "TAR")
+        if (isOp(n, OP_TAR))
         {
-            QuadExp e;
-            e.op = "TAR";
-
-            //e.a1 = (nodes[n->left]->isLeaf() ? nodes[n->left]->value : nodes[n->left]->symList[0]);
-            if (nodes[n->left]->isLeaf())
-                e.a1 = nodes[n->left]->value;
-            else if (isFutileSET(nodes[n->left], outActive))
-                e.a1 = nodes[nodes[n->left]->left]->value;
-            else
-                e.a1 = nodes[n->left]->symList[0];
-
-
-            //e.a2 = (nodes[n->right]->isLeaf() ? nodes[n->right]->value : nodes[n->right]->symList[0]);
-            if (nodes[n->right]->isLeaf())
-                e.a2 = nodes[n->right]->value;
-            else if (isFutileSET(nodes[n->right], outActive))
-                e.a2 = nodes[nodes[n->right]->left]->value;
-            else
-                e.a2 = nodes[n->right]->symList[0];
-
-            //e.a3 = (nodes[n->tri]->isLeaf() ? nodes[n->tri]->value : nodes[n->tri]->symList[0]);
-            if (nodes[n->tri]->isLeaf())
-                e.a3 = nodes[n->tri]->value;
-            else if (isFutileSET(nodes[n->tri], outActive))
-                e.a3 = nodes[nodes[n->tri]->left]->value;
-            else
-                e.a3 = nodes[n->tri]->symList[0];
-
-
-            result.emplace_back(e);
-            return result;
+            result.emplace_back(OP_TAR, nodeNames[k.left], nodeNames[k.right], nodeNames[k.tri]);
+            return;
         }
 
         QuadExp e;
-        e.op = n->value;
-        e.a1 = n->symList[0];
-        if (n->left == -1)
-            e.a2 = "-";
-        else
-        {
-            //e.a2 = (nodes[n->left]->isLeaf() ? nodes[n->left]->value : nodes[n->left]->symList[0]);
-            if (nodes[n->left]->isLeaf())
-                e.a2 = nodes[n->left]->value;
-            else if (isFutileSET(nodes[n->left], outActive))
-                e.a2 = nodes[nodes[n->left]->left]->value;
-            else
-                e.a2 = nodes[n->left]->symList[0];
-        }
-
-        if (n->right == -1)
-            e.a3 = "-";
-        else
-        {
-            //e.a3 = (nodes[n->right]->isLeaf() ? nodes[n->right]->value : nodes[n->right]->symList[0]);
-            if (nodes[n->right]->isLeaf())
-                e.a3 = nodes[n->right]->value;
-            else if (isFutileSET(nodes[n->right], outActive))
-                e.a3 = nodes[nodes[n->right]->left]->value;
-            else
-                e.a3 = nodes[n->right]->symList[0];
-        }
+        e.op = uint8_t(nodeValue[n].id);
+        e.setOperand(1, Operand::name(symList[0]));
+        if (k.left != -1)
+            e.setOperand(2, nodeNames[k.left]);
+        if (k.right != -1)
+            e.setOperand(3, nodeNames[k.right]);
 
         result.emplace_back(e);
 
-        for (auto it = n->symList.begin(); it != n->symList.end(); ++it)
+        for (auto it = symList.begin(); it != symList.end(); ++it)
         {
-            if (it != n->symList.begin())
-            {
-                e.op = "SET";
-                e.a1 = *it;
-                e.a2 = n->symList[0];
-                e.a3 = "-";
-                result.emplace_back(e);
-            }
+            if (it != symList.begin())
+                result.emplace_back(OP_SET, Operand::name(*it), Operand::name(symList[0]));
         }
-
-        return result;
     }
 
     // 判断结点 n 是否代表一个无用赋值语句（形如 T = N ，其中 T 为非活跃变量）
-    bool isFutileSET(std::shared_ptr<DAGNode> n, const std::vector<std::string>& active) const
+    bool isFutileSET(int n) const
     {
         // 没有活跃变量的SET语句结点是无用的
-        if (
-            n != nullptr &&
-            n->value == "SET" &&
-            nodes[n->left]->isLeaf() &&
-            intersection(n->symList, active).empty()
-            )
-        {
-            return true;
-        }
-        return false;
+        return isOp(n, OP_SET) && !(nodeFlags[n] & NODE_KEPT) && isLeaf(nodeKids[n].left) && !anyIn(nodeSyms[n], liveOut);
     }
 
 public:
 
-    // 读取一个四元式
-    std::vector<size_t> readQuad(const QuadExp& E)
+    // 默认使用索引的最小四元式数，取自 DAGBench sweep 测得的分界：
+    // 构造 DAG 的耗时在 2 个四元式时两者相当，从 3 个起索引较快
+    static constexpr size_t DefaultIndexThreshold = 3;
+
+    // 读取一个四元式，返回新建结点的编号（引用在下一次 readQuad 前有效）
+    const std::vector<size_t>& readQuad(const QuadExp& E)
     {
-        if (E.op == "JMP")
+        newNodes.clear();
+        ++stats.quadsIn;
+
+        if (E.op == OP_JMP)
         {
             jumperRec = E;
-            return std::vector<size_t>{};
+            return newNodes;
         }
 
-        if (E.op == "HALT")
+        if (E.op == OP_HALT)
         {
             haltRec = E;
-            return std::vector<size_t>{};
+            return newNodes;
         }
 
-        switch (const int T = E.type())
+        // 无法识别的语句不生成DAG
+        if (E.op == OP_NONE)
+            return newNodes;
+
+        switch (E.type())
         {
             case 0:
                 return readQuad0(E);
@@ -578,223 +762,420 @@ public:
             case 3:
                 return readQuad3(E);
             default:
-                return std::vector<size_t>{};
+                return newNodes;
         }
     }
 
+    // 按基本块的四元式数选择查找方式，须在 reset() 之后、第一次 readQuad 之前调用
+    // 不调用时按小基本块处理；两种方式的结果完全相同
+    void setQuadCount(size_t quads)
+    {
+        indexed = quads >= indexThreshold;
+    }
+
+    // 设置使用索引的基本块的最小四元式数
+    void setIndexThreshold(size_t quads)
+    {
+        indexThreshold = quads;
+    }
+
+    // 设置删除无用结点后是否将剩余结点重新连续编号，默认开启
+    void setCompaction(bool on)
+    {
+        compaction = on;
+    }
+
+    // 本基本块的优化效果计数
+    const OptCounters& counters() const
+    {
+        return stats;
+    }
+
+    // 本基本块的名字表，解析三地址代码与输出优化结果时使用
+    SymbolTable& symbols()
+    {
+        return syms;
+    }
+
+    const SymbolTable& symbols() const
+    {
+        return syms;
+    }
+
     // 打印 DAG
     std::string print_DAG() const
     {
         std::ostringstream os;
-        for (size_t i = 0; i < nodes.size(); ++i)
+        auto childText = [&](int c) -> std::string
+        {
+            return c == -1 ? "-1" : " " + operandText(nodeValue[c], syms);
+        };
+
+        for (size_t n = 0; n < nodeCount; ++n)
         {
-            if (nodes[i] == nullptr)
+            if (isDead(n))
                 continue;
-            os << "Node: n" << i << "\n";
-            os << "Mark: " << nodes[i]->value << "\n";
-            os << "Leaf:" << (nodes[i]->isLeaf() ? "Y" : "N") << "\n";
+            os << "Node: n" << (originalIndex.empty() ? int(n) : originalIndex[n]) << "\n";
+            os << "Mark: " << operandText(nodeValue[n], syms) << "\n";
+            os << "Leaf:" << (isLeaf(n) ? "Y" : "N") << "\n";
             os << "Symbols:";
-            for (auto&& sym : nodes[i]->symList)
-                os << sym << " ";
+            for (auto&& sym : nodeSyms[n])
+                os << syms.name(sym) << " ";
             os << "\n";
 
-            os << "left: " << (nodes[i]->left == -1 ? "-1" : " " + nodes[nodes[i]->left]->value) << "\t";
-            os << "right: " << (nodes[i]->right == -1 ? "-1" : " " + nodes[nodes[i]->right]->value) << "\t";
-            os << "tri: " << (nodes[i]->tri == -1 ? "-1" : " " + nodes[nodes[i]->tri]->value) << "\t";
+            os << "left: " << childText(nodeKids[n].left) << "\t";
+            os << "right: " << childText(nodeKids[n].right) << "\t";
+            os << "tri: " << childText(nodeKids[n].tri) << "\t";
             os << "\n\n";
         }
        
         return os.str();
     }
 
-    // 返回优化后的代码
-    std::vector<QuadExp> genOptimizedCode(std::vector<std::string> outActive)
+    // 返回优化后的代码（引用在下一次 genOptimizedCode 或 reset 前有效）
+    // outActive 为出口活跃变量的编号集合
+    const std::vector<QuadExp>& genOptimizedCode(const SymbolBitset& outActive)
     {
-        std::vector<QuadExp> result;
-        bool changed = true;
+        std::vector<QuadExp>& result = optimizedCode;
+        result.clear();
+        std::pmr::memory_resource* res = arena.resource();
+        size_t count = nodeCount;
 
-        //删除不活跃的根结点
-        while (changed)
-        {
-            changed = false;
+        liveOut = outActive;
 
-            for (auto it = nodes.begin(); it != nodes.end(); ++it)
-                if (isRoot(*it) && !isActiveNode(*it, outActive))
-                {
-                    *it = nullptr;
-                    changed = true;
-                }
+        //之后会删除结点与标识符并重新编号，索引不再同步维护，此后的查找改为线性扫描
+        indexed = false;
+
+        //结点 n 的不重复的子结点
+        auto forEachChild = [&](size_t n, auto&& f)
+        {
+            const NodeKids& k = nodeKids[n];
+            if (k.left != -1)
+                f(k.left);
+            if (k.right != -1 && k.right != k.left)
+                f(k.right);
+            if (k.tri != -1 && k.tri != k.left && k.tri != k.right)
+                f(k.tri);
+        };
+
+        //各结点的属性只计算一次，生成代码时直接读取
+        for (size_t n = 0; n < count; ++n)
+            nodeFlags[n] = isActiveNode(n) ? NODE_ACTIVE : 0;
+
+        //删除不活跃的根结点：父结点全部被删除的不活跃结点随之成为根结点被删除
+        std::pmr::vector<int> parents(count, 0, res);
+        for (size_t n = 0; n < count; ++n)
+            forEachChild(n, [&](int c) { ++parents[c]; });
+
+        std::pmr::vector<int> dead(res);
+        for (size_t n = 0; n < count; ++n)
+            if (parents[n] == 0 && !(nodeFlags[n] & NODE_ACTIVE))
+                dead.emplace_back(int(n));
+        while (!dead.empty())
+        {
+            int n = dead.back();
+            dead.pop_back();
+            forEachChild(n, [&](int c) {
+                if (--parents[c] == 0 && !(nodeFlags[c] & NODE_ACTIVE))
+                    dead.emplace_back(c);
+            });
+            nodeFlags[n] |= NODE_DEAD;
+            ++stats.deadRoots;
         }
 
+        //将剩余结点重新连续编号，之后的各趟遍历不再需要跳过空洞
+        if (compaction)
+            count = compactNodes(parents);
+
         //清除不活跃的标识符，为标识符为空的结点新增一个 Si 标识符
         size_t symSerial = 0;
 
-        for (auto&& node : nodes)
+        for (size_t n = 0; n < count; ++n)
         {
-            if (node == nullptr)
+            if (isDead(n))
                 continue;
-            if (node->value == "TAR")
+            // 写数组结点没有标识符，条件跳转结点的标识符是跳转目标的标号，都不可删除
+            if (isOp(n, OP_TAR) || (nodeValue[n].kind == OPD_OP && isConditionalJump(nodeValue[n].id)))
                 continue;
 
-            for (auto it = node->symList.begin(); it < node->symList.end();)
+            auto& symList = nodeSyms[n];
+            for (auto it = symList.begin(); it < symList.end();)
             {
-                if (!contain(outActive, *it))
-                    it = node->symList.erase(it);
+                if (!liveOut.test(*it))
+                    it = symList.erase(it);
                 else
                     ++it;
             }
 
-            if (!node->isLeaf() && node->symList.empty())
-                node->symList.emplace_back(std::string{ "S" + std::to_string(symSerial++) });
+            if (!isLeaf(n) && symList.empty())
+                symList.emplace_back(syms.intern("S" + std::to_string(symSerial++)));
 
         }
 
-        //DFS自下而上生成代码
-        //查找根结点
-        std::vector<std::shared_ptr<DAGNode>> allRoots = [=]()->std::vector<std::shared_ptr<DAGNode>> {
-            std::vector<std::shared_ptr<DAGNode>> roots;
-            for (auto&& node : nodes)
+        //条件跳转结束基本块，总是在所有其他代码之后生成。它读取的无用赋值输出的是被赋的值，
+        //若该名字在块内被重新赋值，跳转时已读不到旧值，因此仍生成这一赋值，将旧值先保存到它的临时变量 Si
+        for (size_t n = 0; n < count; ++n)
+        {
+            if (isDead(n) || nodeValue[n].kind != OPD_OP || !isConditionalJump(nodeValue[n].id))
+                continue;
+            for (int kid : { nodeKids[n].left, nodeKids[n].right })
             {
-                if (node == nullptr)
+                if (kid == -1 || !isFutileSET(kid))
                     continue;
-                if (isRoot(node))
-                    roots.emplace_back(node);
+                if (findNodeBySymbol(nodeValue[nodeKids[kid].left]) != -1)
+                    nodeFlags[kid] |= NODE_KEPT;
             }
-            return roots;
-        }();
-        //记录各结点是否被访问过，叶子和无用的赋值初始化就认为是访问过的，即不生成代码
-        std::vector<bool> visited(nodes.size(), false);
-        for (size_t i = 0; i < visited.size(); ++i)
-        {
-            if (nodes[i] == nullptr)
-                continue;
-            if (nodes[i]->isLeaf() || isFutileSET(nodes[i], outActive))
-                visited[i] = true;
         }
 
-        //依次从每个根结点dfs
-        for (auto&& root : allRoots)
+        //根结点、无用的赋值及各结点作为操作数时输出的名字：
+        //叶子输出其值，无用的赋值输出被赋的值，其余结点输出其第一个标识符
+        nodeNames.assign(count, Operand{});
+        for (size_t n = 0; n < count; ++n)
         {
-            std::stack<std::shared_ptr<DAGNode>> stk;
-            stk.push(root);
+            if (isDead(n))
+                continue;
+            if (parents[n] == 0)
+                nodeFlags[n] |= NODE_ROOT;
 
-            while (!stk.empty())
+            if (isLeaf(n))
+                nodeNames[n] = nodeValue[n];
+            else if (isFutileSET(n))
             {
-                std::shared_ptr<DAGNode> cur = stk.top();
-                stk.pop();
-                if (visited[findNode(cur)])
-                    continue;
-
+                nodeFlags[n] |= NODE_FUTILE;
+                ++stats.futileSets;
+                nodeNames[n] = nodeValue[nodeKids[n].left];
+            }
+            else
+                nodeNames[n] = Operand::name(nodeSyms[n][0]);
+        }
 
-                //如果对某一个要生成代码的结点，图中有它的同名叶结点
-                //则必须先解决依赖于这些叶结点的结点
-                std::vector<std::shared_ptr<DAGNode>> sameNameLeaves;
-                std::vector<std::shared_ptr<DAGNode>> dependingNodesNotVisited;
+        //叶子和无用的赋值不生成代码
+        auto silent = [&](size_t n)
+        {
+            return isLeaf(n) || (nodeFlags[n] & NODE_FUTILE);
+        };
 
-                for (auto&& sym : cur->symList)
-                    if (auto n = findNodeByValue(sym, -1, -1, -1); n != nullptr)
-                        sameNameLeaves.emplace_back(n);
+        //DFS自下而上生成代码
+        //先一次性建立依赖图，结点 n 生成代码前需要先处理的结点依次为 deps[depStart[n] .. depStart[n + 1])：
+        //  1. 与它的标识符同名的叶结点的其他使用者，它们必须在该名字被覆盖之前读取旧值；
+        //     无用的赋值输出被赋的值，其使用者读取的也是该叶结点，前 nameEnd[n] - depStart[n] 个为这类依赖
+        //  2. 同一数组上必须先执行的读写，不同数组的操作之间互不约束
+        //  3. 条件跳转结束基本块，依赖在它之前的所有其他根结点
+        //  4. 子结点
+        //之后按后序遍历一次，每个结点和每条边只处理一次
+        //各结点的使用者 users[userStart[n] .. userStart[n + 1])，按编号升序
+        std::pmr::vector<int> userStart(count + 1, 0, res);
+        for (size_t n = 0; n < count; ++n)
+            if (!isDead(n))
+                forEachChild(n, [&](int c) { ++userStart[c + 1]; });
+        for (size_t n = 0; n < count; ++n)
+            userStart[n + 1] += userStart[n];
+
+        std::pmr::vector<int> users(userStart[count], res);
+        std::pmr::vector<int> fill(userStart.begin(), userStart.end() - 1, res);
+        for (size_t n = 0; n < count; ++n)
+            if (!isDead(n))
+                forEachChild(n, [&](int c) { users[fill[c]++] = int(n); });
+
+        //各名字对应的叶结点
+        std::pmr::vector<int> leafOfName(syms.size(), -1, res);
+        for (size_t n = 0; n < count; ++n)
+            if (!isDead(n) && isLeaf(n) && nodeValue[n].kind == OPD_NAME
+                && leafOfName[nodeValue[n].id] == -1)
+                leafOfName[nodeValue[n].id] = int(n);
+
+        //各结点的依赖，按访问顺序排列
+        std::pmr::vector<int> depStart(count + 1, 0, res);
+        std::pmr::vector<int> nameEnd(count, 0, res);
+        std::pmr::vector<int> deps(res);
+        for (size_t n = 0; n < count; ++n)
+        {
+            depStart[n] = int(deps.size());
+            nameEnd[n] = int(deps.size());
+            if (isDead(n) || isLeaf(n))
+                continue;
 
-                for (auto&& snl : sameNameLeaves)
+            size_t first = deps.size();
+            for (auto&& sym : nodeSyms[n])
+            {
+                int leaf = leafOfName[sym];
+                if (leaf == -1)
+                    continue;
+                for (int k = userStart[leaf]; k < userStart[leaf + 1]; ++k)
                 {
-                    std::vector<size_t> self = { (size_t)findNode(cur) };
-                    auto nodesDependOnThisLeaf = difference(findNodesDependingOn(snl), self);
-                    for (auto&& index : nodesDependOnThisLeaf)
-                        if (visited[index] == false)
-                            dependingNodesNotVisited.emplace_back(nodes[index]);
+                    int user = users[k];
+                    if (user != int(n))
+                        deps.emplace_back(user);
+                    if (silent(user))
+                        for (int u = userStart[user]; u < userStart[user + 1]; ++u)
+                            if (users[u] != int(n))
+                                deps.emplace_back(users[u]);
                 }
+            }
+            std::reverse(deps.begin() + first, deps.end());
+            nameEnd[n] = int(deps.size());
+
+            //被删除的读不再约束之后的写
+            for (auto&& m : nodeMemDeps[n])
+                if (!isDead(m))
+                    deps.emplace_back(m);
+
+            if (nodeValue[n].kind == OPD_OP && isConditionalJump(nodeValue[n].id))
+                for (size_t r = 0; r < n; ++r)
+                    if (!isDead(r) && (nodeFlags[r] & NODE_ROOT) && !silent(r))
+                        deps.emplace_back(int(r));
+
+            const NodeKids& k = nodeKids[n];
+            if (k.tri != -1)
+                deps.emplace_back(k.tri);
+            if (k.right != -1)
+                deps.emplace_back(k.right);
+            if (k.left != -1)
+                deps.emplace_back(k.left);
+        }
+        depStart[count] = int(deps.size());
+
+        //同名叶结点的约束可能与其他依赖成环，如 a = b; b = c; c = a。子结点、数组操作与条件跳转依赖的根结点的编号都更小，
+        //因此环上至少有一条同名叶结点的约束。遇到环时将该约束的起点改为赋给新的临时变量 Si，去掉它的这类依赖，
+        //弹出栈中在它之上的结点后继续遍历，其原有的标识符在所有代码生成后再由 Si 赋值
+        //depPos[i] 为结点 i 下一个要处理的依赖，只在该依赖已生成代码后前进，被弹出的结点再次入栈时从这里继续，
+        //因此每条边只前进一次，遇到环也不必重新遍历
+        std::pmr::vector<int> depPos(depStart.begin(), depStart.end() - 1, res);
+        std::pmr::vector<QuadExp> deferred(res);
+        std::pmr::vector<bool> visited(count, false, res);
+        std::pmr::vector<bool> onStack(count, false, res);
+        std::pmr::vector<int> stk(res);
+        for (size_t n = 0; n < count; ++n)
+            visited[n] = !isDead(n) && silent(n);
 
-                if (!dependingNodesNotVisited.empty())
-                {
-                    stk.push(cur);
-                    for (auto&& n : dependingNodesNotVisited)
-                        stk.push(n);
-                    continue;
-                }
+        //依次从每个根结点dfs
+        for (size_t root = 0; root < count; ++root)
+        {
+            if (!(nodeFlags[root] & NODE_ROOT) || visited[root])
+                continue;
 
-                if (cur->value == "TAR" || cur->value == "FAR")
+            stk.emplace_back(int(root));
+            onStack[root] = true;
+
+            while (!stk.empty())
+            {
+                int cur = stk.back();
+                if (depPos[cur] < depStart[cur + 1])
                 {
-                    std::vector<std::shared_ptr<DAGNode>> prefArrOpt;
-                    for (size_t i = 0; i < nodes.size(); ++i)
-                        if (
-                            (nodes[i]->value == "FAR" || nodes[i]->value == "TAR")
-                            && nodes[i]->arrOptSerial < cur->arrOptSerial
-                            && visited[i] == false
-                            )
-                            prefArrOpt.emplace_back(nodes[i]);
-
-                    if (!prefArrOpt.empty())
+                    int d = deps[depPos[cur]];
+                    if (visited[d])
                     {
-                        stk.push(cur);
-                        for (auto&& n : prefArrOpt)
-                            stk.push(n);
+                        ++depPos[cur];
                         continue;
                     }
-                }
-
-                if (
-                    [=]() ->bool {
-                        if (cur->left != -1 && !visited[cur->left])
-                            return false;
-                            if (cur->right != -1 && !visited[cur->right])
-                                return false;
-                            if (cur->tri != -1 && !visited[cur->tri])
-                                return false;
-                            return true;
-                    }()
-                                )
-                {
-                    // 如果所有子结点都被访问过，则生成代码
-                    std::vector<QuadExp> nodeCode = genCode(cur, outActive);
-                    for (auto&& c : nodeCode)
+                    if (!onStack[d])
                     {
-                        result.emplace_back(c);
+                        onStack[d] = true;
+                        stk.emplace_back(d);
+                        continue;
                     }
-                    visited[findNode(cur)] = true;
-                }
-                else
-                {
-                    stk.push(cur);
-                    if (cur->left != -1 && !visited[cur->left])
-                        stk.push(nodes[cur->left]);
-
-                    if (cur->right != -1 && !visited[cur->right])
-                        stk.push(nodes[cur->right]);
-
-                    if (cur->tri != -1 && !visited[cur->tri])
-                        stk.push(nodes[cur->tri]);
 
+                    //栈中从 d 到栈顶构成环，取环上最先出现的同名叶结点约束的起点改名
+                    size_t v = stk.size();
+                    for (size_t k = stk.size(); k-- > 0; )
+                    {
+                        if (depPos[stk[k]] < nameEnd[stk[k]])
+                            v = k;
+                        if (stk[k] == d)
+                            break;
+                    }
+                    assert(v != stk.size());
+                    int victim = stk[v];
+
+                    uint32_t temp = syms.intern("S" + std::to_string(symSerial++));
+                    auto& symList = nodeSyms[victim];
+                    for (auto&& sym : symList)
+                        deferred.emplace_back(OP_SET, Operand::name(sym), Operand::name(temp));
+                    symList[0] = temp;
+                    while (symList.size() > 1)
+                        symList.erase(symList.end() - 1);
+                    nodeNames[victim] = Operand::name(temp);
+                    depPos[victim] = nameEnd[victim];
+
+                    //在它之上的结点都在等待环上的结点，弹出后由其他依赖或根结点再次访问
+                    while (stk.size() > v + 1)
+                    {
+                        onStack[stk.back()] = false;
+                        stk.pop_back();
+                    }
+                    continue;
                 }
 
+                // 所有依赖都已处理，生成代码
+                genCode(cur, result);
+                visited[cur] = true;
+                onStack[cur] = false;
+                stk.pop_back();
             }
-
         }
 
-        if (jumperRec.op == "JMP")
+        //改名的结点的标识符最后赋值，条件跳转结束基本块，赋值插在它之前
+        auto at = result.end();
+        if (!result.empty() && isConditionalJump(result.back().op))
+            --at;
+        result.insert(at, deferred.begin(), deferred.end());
+
+        if (jumperRec.op == OP_JMP)
             result.push_back(jumperRec);
-        if (haltRec.op == "HALT")
+        if (haltRec.op == OP_HALT)
             result.push_back(haltRec);
 
-
+        stats.quadsOut = result.size();
         return result;
     }
 
-    void release()
+    // 清空 DAG 以处理下一个基本块，保留各结点数组及临时容器的容量
+    // 稳定状态下处理小基本块时不再重新分配这些存储
+    void reset()
     {
-        for (auto&& node : nodes)
-        {
-            if (node != nullptr)
-            {
-                node = nullptr;
-            }
-        }
-        nodes.clear();
+        nodeCount = 0;
+        syms.reset();
+        literalLeaves.reset();
+        newNodes.clear();
+        optimizedCode.clear();
+        arena.release();
         jumperRec.clear();
         haltRec.clear();
-        arrOptSerial = 0;
+        arrayChainIndex.reset();
+        chainsUsed = 0;
+        originalIndex.clear();
+        stats = OptCounters{};
+
+        for (size_t i = 0; i < symbolOwnersUsed; ++i)
+            symbolOwners[i].clear();
+        symbolOwnersUsed = 0;
+        if (valueCount != 0)
+            std::fill(valueSlots.begin(), valueSlots.end(), 0);
+        valueCount = 0;
+        indexed = false;
+    }
+
+    // 清空 DAG 并释放所有存储
+    void release()
+    {
+        reset();
+        nodeValue = {};
+        nodeKids = {};
+        nodeFlags = {};
+        nodeEpoch = {};
+        nodeSyms = {};
+        nodeMemDeps = {};
+        arrayChains = {};
+        newNodes = {};
+        optimizedCode = {};
+        nodeNames = {};
+        originalIndex = {};
+        symbolOwners = {};
+        valueSlots = {};
+        arena.shrink();
     }
 
 };
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,776 @@
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <cstdio>
+#include <fstream>
+#include <cmath>
+#include <unordered_map>
+#include "DAG.hpp"
+#include "convert.hpp"
+#include "json.hpp"
+#include "workload.hpp"
+#include "alloc.hpp"
+
+using json = nlohmann::json;
+
+// 基本块优化的基准测试
+// 编译：g++ -std=c++17 -O2 DAGBench.cpp -o DAGBench
+// 运行：./DAGBench [块数] [每块四元式数] [种子]   分阶段统计每个四元式的耗时与堆分配次数
+//       ./DAGBench layout [结点数]     比较结点的两种存储布局
+//       ./DAGBench sweep               比较不同大小的基本块上线性查找与哈希索引的耗时
+//       ./DAGBench gate [基线文件] [轮数] [阈值]   在固定的负载上与基线比较，有阶段变慢超过阈值时返回 1
+//       ./DAGBench baseline [基线文件] [轮数] [重复次数]   重复测量并写出新的基线
+
+
+// 以固定种子生成 count 个长度为 size 的基本块（另加结尾的跳转），其余参数取 WorkloadSpec 的默认值
+std::vector<SyntheticBlock> makeBlocks(size_t count, size_t size, unsigned seed = 42)
+{
+    WorkloadSpec spec;
+    spec.seed = seed;
+    spec.minSize = spec.maxSize = size;
+
+    WorkloadGenerator gen(spec);
+    std::vector<SyntheticBlock> blocks;
+    blocks.reserve(count);
+    for (size_t k = 0; k < count; ++k)
+        blocks.emplace_back(gen.next());
+    return blocks;
+}
+
+struct PhaseResult
+{
+    size_t buildAllocs = 0;
+    size_t emitAllocs = 0;
+    double ns = 0;
+    double buildNs = 0;     // 其中构造 DAG 的耗时
+};
+
+// 依次优化所有基本块，reuse 为 true 时复用同一个 DAG 工作区
+// compact 为 false 时删除无用结点后不重新编号，threshold 为使用哈希索引的最小四元式数
+PhaseResult run(const std::vector<SyntheticBlock>& blocks, bool reuse, bool compact = true, size_t threshold = DAG::DefaultIndexThreshold)
+{
+    PhaseResult r;
+    DAG workspace;
+    workspace.setCompaction(compact);
+    workspace.setIndexThreshold(threshold);
+
+    // 解析三地址代码不计入统计
+    std::vector<QuadExp> quads;
+    SymbolBitset out;
+
+    auto process = [&](DAG& D, const SyntheticBlock& blk)
+    {
+        SymbolTable& syms = D.symbols();
+        quads.clear();
+        out.reset(0);
+        for (auto&& tri : blk.code)
+            quads.emplace_back(convert(tri, syms));
+        for (auto&& var : blk.out)
+            out.set(syms.intern(var));
+        D.setQuadCount(quads.size());
+
+        auto start = std::chrono::steady_clock::now();
+        size_t before = allocTracker.count;
+        for (auto&& E : quads)
+            D.readQuad(E);
+        r.buildAllocs += allocTracker.count - before;
+        r.buildNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        before = allocTracker.count;
+        D.genOptimizedCode(out);
+        r.emitAllocs += allocTracker.count - before;
+        auto stop = std::chrono::steady_clock::now();
+        r.ns += std::chrono::duration<double, std::nano>(stop - start).count();
+    };
+
+    // 预热，使复用模式达到稳定状态
+    if (reuse)
+        for (auto&& blk : blocks)
+        {
+            workspace.reset();
+            process(workspace, blk);
+        }
+    r = PhaseResult{};
+
+    for (auto&& blk : blocks)
+    {
+        if (reuse)
+        {
+            workspace.reset();
+            process(workspace, blk);
+        }
+        else
+        {
+            DAG D;
+            D.setCompaction(compact);
+            D.setIndexThreshold(threshold);
+            process(D, blk);
+        }
+    }
+    return r;
+}
+
+// 结点布局对比
+// 旧布局：与改动前的 DAGNode 字段相同，每个结点一个堆对象，由结点池分配并经指针数组访问，
+// 冷热字段混在一起，标志位也存放在结点内
+struct PointerNode
+{
+    SmallVector<uint32_t, 3> symList;
+    int left = -1;
+    int right = -1;
+    int tri = -1;
+    Operand value;
+    uint32_t epoch = 0;
+    uint8_t flags = 0;
+    SmallVector<int, 2> memDeps;
+};
+
+// 新布局：值、子结点与标志各自为连续数组
+struct ArrayNodes
+{
+    std::vector<Operand> value;
+    std::vector<NodeKids> kids;
+    std::vector<uint8_t> flags;
+};
+
+// 删除无用结点与后序遍历两趟，与 genOptimizedCode 中的做法相同
+// kids(i) 返回结点 i 的子结点，active(i) 判断结点 i 是否活跃，返回生成代码的结点数
+template<typename Kids, typename Active>
+size_t passes(size_t n, Kids&& kids, Active&& active, std::vector<int>& parents, std::vector<uint8_t>& state)
+{
+    parents.assign(n, 0);
+    state.assign(n, 0);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const NodeKids& k = kids(i);
+        for (int c : { k.left, k.right, k.tri })
+            if (c != -1)
+                ++parents[c];
+    }
+
+    std::vector<int> work;
+    for (size_t i = 0; i < n; ++i)
+        if (parents[i] == 0 && !active(i))
+            work.push_back(int(i));
+    while (!work.empty())
+    {
+        int i = work.back();
+        work.pop_back();
+        state[i] = 1;
+        const NodeKids& k = kids(i);
+        for (int c : { k.left, k.right, k.tri })
+            if (c != -1 && --parents[c] == 0 && !active(c))
+                work.push_back(c);
+    }
+
+    size_t emitted = 0;
+    std::vector<std::pair<int, int>> stk;
+    for (size_t root = 0; root < n; ++root)
+    {
+        if (state[root] != 0 || parents[root] != 0)
+            continue;
+        stk.emplace_back(int(root), 0);
+        while (!stk.empty())
+        {
+            int cur = stk.back().first;
+            int& next = stk.back().second;
+            const NodeKids& k = kids(cur);
+            if (next < 3)
+            {
+                int c = next == 0 ? k.tri : next == 1 ? k.right : k.left;
+                ++next;
+                if (c != -1 && state[c] == 0)
+                {
+                    state[c] = 2;
+                    stk.emplace_back(c, 0);
+                }
+                continue;
+            }
+            state[cur] = 3;
+            ++emitted;
+            stk.pop_back();
+        }
+    }
+    return emitted;
+}
+
+void layoutBench(size_t n)
+{
+    unsigned seed = 42;
+    auto rnd = [&](unsigned m) -> unsigned
+    {
+        seed = seed * 1103515245u + 12345u;
+        return (seed >> 8) % m;
+    };
+
+    // 前八分之一为叶子，其余结点的子结点从之前的结点中随机选取，约七分之一的结点活跃
+    ArrayNodes arrays;
+    arrays.value.resize(n);
+    arrays.kids.resize(n);
+    arrays.flags.resize(n);
+    for (size_t i = n / 8; i < n; ++i)
+    {
+        arrays.value[i] = Operand::op(OP_ADD + rnd(3));
+        arrays.kids[i].left = int(rnd(unsigned(i)));
+        arrays.kids[i].right = int(rnd(unsigned(i)));
+        arrays.flags[i] = rnd(7) == 0;
+    }
+
+    // 旧布局的结点池：结点按 order 的顺序分配
+    std::vector<std::unique_ptr<PointerNode>> pool;
+    auto buildPool = [&](const std::vector<size_t>& order)
+    {
+        pool.clear();
+        pool.resize(n);
+        std::vector<PointerNode*> pointers(n);
+        for (size_t i : order)
+        {
+            pool[i] = std::make_unique<PointerNode>();
+            pointers[i] = pool[i].get();
+            pointers[i]->value = arrays.value[i];
+            pointers[i]->left = arrays.kids[i].left;
+            pointers[i]->right = arrays.kids[i].right;
+            pointers[i]->flags = arrays.flags[i];
+            pointers[i]->symList.push_back(uint32_t(i));
+        }
+        return pointers;
+    };
+
+    std::vector<int> parents;
+    std::vector<uint8_t> state;
+    size_t emitted = 0;
+    bool mismatch = false;
+    auto measure = [&](auto&& kids, auto&& active)
+    {
+        const int rounds = 20;
+        size_t check = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r)
+            check = passes(n, kids, active, parents, state);
+        auto stop = std::chrono::steady_clock::now();
+        mismatch |= emitted != 0 && check != emitted;
+        emitted = check;
+        return std::chrono::duration<double, std::nano>(stop - start).count() / rounds / n;
+    };
+    auto measurePool = [&](const std::vector<PointerNode*>& pointers)
+    {
+        // 旧布局中 NodeKids 不存在，临时拼出子结点
+        return measure(
+            [&](size_t i) { return NodeKids{ pointers[i]->left, pointers[i]->right, pointers[i]->tri }; },
+            [&](size_t i) { return pointers[i]->value.kind == OPD_OP && pointers[i]->flags; });
+    };
+
+    // 结点池按创建顺序分配，与改动前 DAG 的结点池相同
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; ++i)
+        order[i] = i;
+    double pooled = measurePool(buildPool(order));
+
+    double soa = measure(
+        [&](size_t i) -> const NodeKids& { return arrays.kids[i]; },
+        [&](size_t i) { return arrays.value[i].kind == OPD_OP && arrays.flags[i]; });
+
+    // 附加对比：结点按随机顺序分配，模拟被许多其他分配打散的堆
+    for (size_t i = n; i > 1; --i)
+        std::swap(order[i - 1], order[rnd(unsigned(i))]);
+    double shuffled = measurePool(buildPool(order));
+
+    std::cout << "nodes: " << n << ", live nodes emitted: " << emitted
+              << (mismatch ? " (MISMATCH)" : "") << "\n";
+    std::cout << "pooled DAGNode layout    ns/node: " << pooled << "  bytes/node: "
+              << sizeof(PointerNode) + sizeof(PointerNode*) << "\n";
+    std::cout << "struct-of-arrays layout  ns/node: " << soa << "  bytes/node (hot): "
+              << sizeof(Operand) + sizeof(NodeKids) + sizeof(uint8_t) << "\n";
+    std::cout << "pooled, shuffled heap    ns/node: " << shuffled << "\n";
+}
+
+// 分阶段统计：读入 json、解析三地址代码、构造 DAG、生成代码、输出三地址代码、写出 json
+// 各阶段与 DAGOpt 中的做法相同，工作区先完整处理一遍以达到稳定状态
+void phaseBench(const std::vector<SyntheticBlock>& blocks)
+{
+    enum { LOAD, PARSE, BUILD, EMIT, FORMAT, DUMP, PHASES };
+    const char* names[PHASES] = { "json load", "convert", "readQuad", "genOptimizedCode", "convert2tri", "json dump" };
+    double ns[PHASES] = {};
+    size_t allocs[PHASES] = {};
+
+    using clock = std::chrono::steady_clock;
+    clock::time_point start;
+    size_t before = 0;
+    auto begin = [&]()
+    {
+        before = allocTracker.count;
+        start = clock::now();
+    };
+    auto end = [&](int phase)
+    {
+        auto stop = clock::now();
+        ns[phase] += std::chrono::duration<double, std::nano>(stop - start).count();
+        allocs[phase] += allocTracker.count - before;
+    };
+
+    // 按输入文件的格式组织合成的基本块
+    json input;
+    input["summary"]["total_blocks"] = blocks.size();
+    size_t quadCount = 0;
+    for (size_t i = 0; i < blocks.size(); ++i)
+    {
+        input["blocks"][std::to_string(i)]["code"] = blocks[i].code;
+        input["blocks"][std::to_string(i)]["out"] = blocks[i].out;
+        quadCount += blocks[i].code.size();
+    }
+    std::string text = input.dump(4);
+
+    begin();
+    json j = json::parse(text);
+    end(LOAD);
+
+    DAG D;
+    std::vector<QuadExp> quads;
+    std::vector<std::string> lines;
+    SymbolBitset out;
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        double saved[PHASES];
+        size_t savedAllocs[PHASES];
+        std::copy(ns, ns + PHASES, saved);
+        std::copy(allocs, allocs + PHASES, savedAllocs);
+
+        for (size_t i = 0; i < blocks.size(); ++i)
+        {
+            const SyntheticBlock& blk = blocks[i];
+            D.reset();
+            D.setQuadCount(blk.code.size());
+            SymbolTable& syms = D.symbols();
+
+            begin();
+            quads.clear();
+            out.reset(0);
+            for (auto&& var : blk.out)
+                out.set(syms.intern(var));
+            for (auto&& tri : blk.code)
+                quads.emplace_back(convert(tri, syms));
+            end(PARSE);
+
+            begin();
+            for (auto&& E : quads)
+                D.readQuad(E);
+            end(BUILD);
+
+            begin();
+            const std::vector<QuadExp>& optcd = D.genOptimizedCode(out);
+            end(EMIT);
+
+            begin();
+            lines.resize(optcd.size());
+            for (size_t k = 0; k < optcd.size(); ++k)
+                lines[k] = convert2tri(optcd[k], syms);
+            end(FORMAT);
+
+            if (pass == 1)
+                j["blocks"][std::to_string(i)]["code"] = lines;
+        }
+
+        // 第一遍仅用于预热
+        if (pass == 0)
+        {
+            std::copy(saved, saved + PHASES, ns);
+            std::copy(savedAllocs, savedAllocs + PHASES, allocs);
+        }
+    }
+
+    begin();
+    std::string result = j.dump(4);
+    end(DUMP);
+
+    std::cout << "phase               ns/quad     allocs/quad\n";
+    for (int p = 0; p < PHASES; ++p)
+    {
+        std::printf("%-18s  %-10.1f  %.3f\n", names[p], ns[p] / quadCount, double(allocs[p]) / quadCount);
+    }
+}
+
+// 在不同大小的基本块上分别强制使用线性查找与哈希索引，用于确定两者的分界
+// 查找方式只影响构造 DAG，因此只比较这一阶段每个四元式的耗时，各取三次中的最小值
+void sweep()
+{
+    std::cout << "quads/block  linear ns/quad  indexed ns/quad\n";
+    std::vector<size_t> sizes = { 1, 2, 3, 4, 6 };
+    for (size_t size = 8; size <= 8192; size *= 2)
+        sizes.emplace_back(size);
+
+    for (size_t size : sizes)
+    {
+        size_t count = std::max<size_t>(4, 1600000 / size / size);
+        count = std::min<size_t>(count, 200000);
+        auto blocks = makeBlocks(count, size);
+        size_t quads = 0;
+        for (auto&& blk : blocks)
+            quads += blk.code.size();
+
+        double linear = 1e300, indexed = 1e300;
+        for (int k = 0; k < 3; ++k)
+        {
+            linear = std::min(linear, run(blocks, true, true, size_t(-1)).buildNs);
+            indexed = std::min(indexed, run(blocks, true, true, 0).buildNs);
+        }
+        std::cout << quads / count << "\t\t" << linear / quads << "\t\t" << indexed / quads << "\n";
+    }
+}
+
+// 性能回归检查
+// 固定的负载由若干种形状的基本块组成，每种形状分别测量解析、构造 DAG、生成代码、输出三地址代码
+// 各阶段每个四元式的耗时与堆分配次数。
+// 机器、频率与负载不同时绝对耗时不可比，因此每轮同时测量一个与优化器无关的参考负载，
+// 各阶段的耗时记为与参考负载耗时之比，取多轮的中位数及其 95% 置信区间（自助法）
+
+struct GateShape
+{
+    const char* name;
+    WorkloadSpec spec;
+};
+
+// 各形状的四元式总数约为 GateQuads
+static const size_t GateQuads = 60000;
+
+std::vector<GateShape> gateShapes()
+{
+    std::vector<GateShape> shapes;
+    auto add = [&](const char* name, size_t minSize, size_t maxSize, auto&& tweak)
+    {
+        WorkloadSpec spec;
+        spec.seed = 1000 + shapes.size();
+        spec.minSize = minSize;
+        spec.maxSize = maxSize;
+        tweak(spec);
+        shapes.push_back({ name, spec });
+    };
+    add("tiny", 2, 6, [](WorkloadSpec&) {});
+    add("small", 8, 24, [](WorkloadSpec&) {});
+    add("large", 128, 512, [](WorkloadSpec& s) { s.vars = 32; });
+    add("redundant", 16, 64, [](WorkloadSpec& s) { s.redundancy = 0.6; });
+    add("constant", 16, 64, [](WorkloadSpec& s) { s.constants = 0.7; });
+    add("arrays", 16, 64, [](WorkloadSpec& s) { s.arrays = 4; s.arrayOps = 0.6; s.stores = 0.5; });
+    add("live-out", 16, 64, [](WorkloadSpec& s) { s.liveOut = 16; s.vars = 16; });
+    return shapes;
+}
+
+enum { GATE_CONVERT, GATE_BUILD, GATE_EMIT, GATE_FORMAT, GATE_PHASES };
+static const char* const gatePhaseNames[GATE_PHASES] = { "convert", "build", "emit", "format" };
+
+// 一轮测量：各阶段每个四元式的耗时与堆分配次数
+struct GateSample
+{
+    double ns[GATE_PHASES] = {};
+    double allocs[GATE_PHASES] = {};
+};
+
+GateSample gatePass(const std::vector<SyntheticBlock>& blocks, DAG& D)
+{
+    using clock = std::chrono::steady_clock;
+    static std::vector<QuadExp> quads;
+    static std::vector<std::string> lines;
+    static SymbolBitset out;
+
+    GateSample r;
+    size_t quadCount = 0;
+    clock::time_point start;
+    size_t before = 0;
+    auto begin = [&]()
+    {
+        before = allocTracker.count;
+        start = clock::now();
+    };
+    auto end = [&](int phase)
+    {
+        auto stop = clock::now();
+        r.ns[phase] += std::chrono::duration<double, std::nano>(stop - start).count();
+        r.allocs[phase] += double(allocTracker.count - before);
+    };
+
+    for (auto&& blk : blocks)
+    {
+        D.reset();
+        D.setQuadCount(blk.code.size());
+        SymbolTable& syms = D.symbols();
+        quadCount += blk.code.size();
+
+        begin();
+        quads.clear();
+        out.reset(0);
+        for (auto&& var : blk.out)
+            out.set(syms.intern(var));
+        for (auto&& tri : blk.code)
+            quads.emplace_back(convert(tri, syms));
+        end(GATE_CONVERT);
+
+        begin();
+        for (auto&& E : quads)
+            D.readQuad(E);
+        end(GATE_BUILD);
+
+        begin();
+        const std::vector<QuadExp>& optcd = D.genOptimizedCode(out);
+        end(GATE_EMIT);
+
+        begin();
+        lines.resize(optcd.size());
+        for (size_t k = 0; k < optcd.size(); ++k)
+            lines[k] = convert2tri(optcd[k], syms);
+        end(GATE_FORMAT);
+    }
+
+    for (int p = 0; p < GATE_PHASES; ++p)
+    {
+        r.ns[p] /= double(quadCount);
+        r.allocs[p] /= double(quadCount);
+    }
+    return r;
+}
+
+// 参考负载：拼接短字符串、在哈希表中插入与查找、对整数排序，与优化器的代码无关，
+// 访存与分支的特点与各阶段相近。返回每个单位的耗时（纳秒）
+double referencePass()
+{
+    using clock = std::chrono::steady_clock;
+    static const size_t Units = 20000;
+    static volatile size_t sink = 0;
+
+    auto start = clock::now();
+    WorkloadRandom rnd(11);
+    std::unordered_map<std::string, size_t> table;
+    std::vector<uint64_t> keys;
+    size_t hits = 0;
+    for (size_t k = 0; k < Units; ++k)
+    {
+        std::string name = "t" + std::to_string(rnd.below(Units / 4));
+        hits += table.count(name);
+        table.emplace(std::move(name), k);
+        keys.emplace_back(rnd.next());
+    }
+    std::sort(keys.begin(), keys.end());
+    sink = sink + hits + size_t(keys[Units / 2]);
+    auto stop = clock::now();
+
+    return std::chrono::duration<double, std::nano>(stop - start).count() / double(Units);
+}
+
+double median(std::vector<double> v)
+{
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+// 中位数的 95% 置信区间：以固定种子重抽样 2000 次
+std::pair<double, double> medianInterval(const std::vector<double>& v)
+{
+    WorkloadRandom rnd(7);
+    std::vector<double> medians, resample(v.size());
+    for (int k = 0; k < 2000; ++k)
+    {
+        for (auto&& x : resample)
+            x = v[rnd.below(v.size())];
+        medians.emplace_back(median(resample));
+    }
+    std::sort(medians.begin(), medians.end());
+    return { medians[medians.size() * 25 / 1000], medians[medians.size() * 975 / 1000] };
+}
+
+// 对每种形状测量 runs 轮，每轮的前后各测一次参考负载，各阶段的耗时除以两次的平均值
+json gateMeasure(size_t runs)
+{
+    json result;
+    result["runs"] = runs;
+    result["unit"] = "ns/quad per reference ns";
+
+    std::vector<double> reference;
+    for (auto&& shape : gateShapes())
+    {
+        WorkloadGenerator gen(shape.spec);
+        std::vector<SyntheticBlock> blocks;
+        for (size_t quads = 0; quads < GateQuads;)
+        {
+            blocks.emplace_back(gen.next());
+            quads += blocks.back().code.size();
+        }
+
+        DAG D;
+        gatePass(blocks, D);    // 预热
+        referencePass();
+        std::vector<GateSample> samples;
+        for (size_t k = 0; k < runs; ++k)
+        {
+            double before = referencePass();
+            GateSample s = gatePass(blocks, D);
+            double ref = (before + referencePass()) / 2;
+            for (int p = 0; p < GATE_PHASES; ++p)
+                s.ns[p] /= ref;
+            samples.emplace_back(s);
+            reference.emplace_back(ref);
+        }
+
+        json& entry = result["shapes"][shape.name];
+        for (int p = 0; p < GATE_PHASES; ++p)
+        {
+            std::vector<double> ns;
+            for (auto&& s : samples)
+                ns.emplace_back(s.ns[p]);
+            auto [lo, hi] = medianInterval(ns);
+            entry[gatePhaseNames[p]] = { {"median", median(ns)}, {"ci_low", lo}, {"ci_high", hi},
+                {"allocs", samples.back().allocs[p]} };
+        }
+    }
+    result["reference_ns"] = median(reference);
+    return result;
+}
+
+// 重复测量 repeats 次作为基线：各项取各次中位数的中位数，
+// spread 为各次中位数偏离它的最大比例，即同一份代码在这台机器上重复测量的波动
+json gateBaseline(size_t runs, size_t repeats)
+{
+    std::vector<json> measured;
+    for (size_t r = 0; r < std::max<size_t>(1, repeats); ++r)
+        measured.emplace_back(gateMeasure(runs));
+
+    json result = measured.front();
+    result["repeats"] = measured.size();
+    for (auto&& [name, phases] : result["shapes"].items())
+    {
+        for (auto&& [phase, entry] : phases.items())
+        {
+            std::vector<double> medians;
+            for (auto&& m : measured)
+                medians.emplace_back(m["shapes"][name][phase]["median"].get<double>());
+            double mid = median(medians), spread = 0;
+            for (auto&& m : medians)
+                spread = std::max(spread, std::abs(m / mid - 1));
+            entry["median"] = mid;
+            entry["spread"] = spread;
+        }
+    }
+    return result;
+}
+
+// 与基线比较，返回是否没有回归
+// 每一项的容许比例取 threshold 与基线 spread 的三倍中的较大者（几次重复测量得到的最大偏离往往低估波动）；
+// 中位数超过基线的 (1 + 容许比例) 倍且置信区间整体高于基线的中位数时判为变慢；
+// 堆分配次数是确定的，比基线多即判为回归
+bool gateCompare(const json& baseline, const json& current, double threshold)
+{
+    std::vector<std::string> regressed;
+    std::printf("reference %.2f ns (baseline %.2f ns)\n\n", current["reference_ns"].get<double>(),
+        baseline.value("reference_ns", 0.0));
+    std::printf("%-10s %-8s %10s %10s %8s %8s\n", "shape", "phase", "baseline", "current", "ratio", "limit");
+
+    for (auto&& [name, phases] : current["shapes"].items())
+    {
+        if (!baseline["shapes"].contains(name))
+        {
+            std::printf("%-10s (not in baseline)\n", name.c_str());
+            continue;
+        }
+        const json& base = baseline["shapes"][name];
+        std::string bad;
+        for (int p = 0; p < GATE_PHASES; ++p)
+        {
+            const char* phase = gatePhaseNames[p];
+            const json& c = phases[phase];
+            const json& b = base[phase];
+            double limit = std::max(threshold, 3 * b.value("spread", 0.0));
+            double ratio = c["median"].get<double>() / b["median"].get<double>();
+            bool slower = ratio > 1 + limit && c["ci_low"].get<double>() > b["median"].get<double>();
+            bool allocs = c["allocs"].get<double>() > b["allocs"].get<double>() + 1e-9;
+
+            std::printf("%-10s %-8s %10.3f %10.3f %7.2fx %7.0f%%%s%s\n", name.c_str(), phase,
+                b["median"].get<double>(), c["median"].get<double>(), ratio, limit * 100,
+                slower ? "  SLOWER" : "", allocs ? "  MORE ALLOCS" : "");
+            if (slower || allocs)
+                bad += std::string(bad.empty() ? "" : ", ") + phase;
+        }
+        if (!bad.empty())
+            regressed.emplace_back(name + " (" + bad + ")");
+    }
+
+    if (regressed.empty())
+    {
+        std::printf("\nno regression beyond the limits\n");
+        return true;
+    }
+    std::printf("\nregressed block shapes:\n");
+    for (auto&& r : regressed)
+        std::printf("  %s\n", r.c_str());
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    // 各测量取 allocTracker.count 的前后之差作为堆分配次数
+    allocTracker.on = true;
+
+    if (argc > 1 && std::string(argv[1]) == "gate")
+    {
+        std::string path = argc > 2 ? argv[2] : "bench_baseline.json";
+        size_t runs = argc > 3 ? std::stoul(argv[3]) : 9;
+        double threshold = argc > 4 ? std::stod(argv[4]) : 0.15;
+
+        std::ifstream in(path);
+        if (!in)
+        {
+            std::cerr << "cannot open baseline " << path << std::endl;
+            return 2;
+        }
+        json baseline;
+        in >> baseline;
+        return gateCompare(baseline, gateMeasure(runs), threshold) ? 0 : 1;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "baseline")
+    {
+        std::string path = argc > 2 ? argv[2] : "bench_baseline.json";
+        size_t runs = argc > 3 ? std::stoul(argv[3]) : 9;
+        size_t repeats = argc > 4 ? std::stoul(argv[4]) : 5;
+        std::ofstream(path) << gateBaseline(runs, repeats).dump(4) << std::endl;
+        std::cout << "baseline written to " << path << std::endl;
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "sweep")
+    {
+        sweep();
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "layout")
+    {
+        layoutBench(argc > 2 ? std::stoul(argv[2]) : 100000);
+        return 0;
+    }
+
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 10000;
+    size_t size = argc > 2 ? std::stoul(argv[2]) : 12;
+    unsigned seed = argc > 3 ? unsigned(std::stoul(argv[3])) : 42;
+
+    auto blocks = makeBlocks(count, size, seed);
+
+    std::cout << "blocks: " << count << ", quads/block: " << size << "\n";
+    phaseBench(blocks);
+    std::cout << "\nDAG workspace (readQuad + genOptimizedCode):\n";
+    for (bool reuse : { false, true })
+    {
+        PhaseResult r = run(blocks, reuse);
+        std::cout << (reuse ? "reused workspace" : "fresh DAG       ")
+                  << "  build allocs/block: " << double(r.buildAllocs) / count
+                  << "  emit allocs/block: " << double(r.emitAllocs) / count
+                  << "  ns/block: " << r.ns / count << "\n";
+    }
+
+    PhaseResult r = run(blocks, true, false);
+    std::cout << "no compaction   "
+              << "  build allocs/block: " << double(r.buildAllocs) / count
+              << "  emit allocs/block: " << double(r.emitAllocs) / count
+              << "  ns/block: " << r.ns / count << "\n";
+
+    return 0;
+}
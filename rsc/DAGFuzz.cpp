@@ -0,0 +1,427 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+#include <cctype>
+#include "DAG.hpp"
+#include "convert.hpp"
+#include "workload.hpp"
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+// 寻找最坏情况的基本块：搜索每个四元式耗时最大的小基本块，化简后保存为回归基准
+// 编译：g++ -std=c++17 -O2 DAGFuzz.cpp -o DAGFuzz
+// 运行：./DAGFuzz [选项]                搜索并写出 worst_cases.json
+//       ./DAGFuzz replay 文件 [阈值]    重新测量保存的基本块，相对耗时超出记录值的 (1 + 阈值) 倍（默认 0.5）
+//                                       或新建结点数、生成的四元式数多于记录值时返回 1
+// 绝对耗时与机器有关，记录的是与参考基本块（referenceBlock）在同一次运行中测得的耗时之比，
+// 以及与机器无关的结构代价：新建结点数与生成的四元式数
+// 选项：
+//   --out=文件        输出文件，默认 worst_cases.json，格式与 DAGOpt 的输入相同
+//   --iterations=N    变异次数，默认 2000
+//   --min-quads=N     基本块的最小四元式数，默认 16；过小的块每个四元式的耗时主要是固定开销
+//   --max-quads=N     基本块的最大四元式数，默认 64
+//   --keep=N          保留的最坏基本块数，默认 8
+//   --seed=N          随机种子，默认 1
+//   --objective=dag|all  dag 只计构造 DAG 与生成代码（默认），all 另计解析三地址代码
+
+
+// 一个候选基本块及其每个四元式的耗时；搜索时为纳秒，化简后为与参考基本块之比
+struct Candidate
+{
+    SyntheticBlock blk;
+    double cost = 0;
+};
+
+// 搜索时每次测量处理的四元式数；记录与重新测量时使用更大的 PreciseBudget 以减小噪声
+static const size_t SearchBudget = 4000;
+static const size_t PreciseBudget = 100000;
+
+// 测量一个基本块每个四元式的耗时（纳秒）：重复处理直至约 budget 个四元式，取 5 轮中的最小值
+double measure(const SyntheticBlock& blk, bool withConvert, size_t budget = SearchBudget)
+{
+    using clock = std::chrono::steady_clock;
+    static DAG D;
+    static std::vector<QuadExp> quads;
+    static SymbolBitset out;
+
+    size_t n = std::max<size_t>(1, blk.code.size());
+    size_t reps = std::max<size_t>(1, budget / n);
+    double best = 0;
+
+    for (int round = 0; round < 5; ++round)
+    {
+        double ns = 0;
+        for (size_t r = 0; r < reps; ++r)
+        {
+            D.reset();
+            D.setQuadCount(blk.code.size());
+            SymbolTable& syms = D.symbols();
+
+            auto start = clock::now();
+            quads.clear();
+            out.reset(0);
+            for (auto&& var : blk.out)
+                out.set(syms.intern(var));
+            for (auto&& tri : blk.code)
+                quads.emplace_back(convert(tri, syms));
+            auto parsed = clock::now();
+
+            for (auto&& E : quads)
+                D.readQuad(E);
+            D.genOptimizedCode(out);
+            auto stop = clock::now();
+
+            ns += std::chrono::duration<double, std::nano>(stop - (withConvert ? start : parsed)).count();
+        }
+        ns /= double(reps * n);
+        if (round == 0 || ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+// 参考基本块：默认参数下以固定种子合成的 32 条四元式
+SyntheticBlock referenceBlock()
+{
+    WorkloadSpec spec;
+    spec.seed = 1;
+    spec.minSize = spec.maxSize = 32;
+    return WorkloadGenerator(spec).next();
+}
+
+// 每个四元式的耗时与参考基本块之比，前后各测一次参考基本块取平均
+double relativeCost(const SyntheticBlock& blk, bool withConvert)
+{
+    static const SyntheticBlock reference = referenceBlock();
+    double before = measure(reference, withConvert, PreciseBudget);
+    double cost = measure(blk, withConvert, PreciseBudget);
+    return cost * 2 / (before + measure(reference, withConvert, PreciseBudget));
+}
+
+// 结构代价：处理一次基本块的新建结点数与生成的四元式数，与机器无关
+std::pair<size_t, size_t> structuralCost(const SyntheticBlock& blk)
+{
+    DAG D;
+    SymbolBitset out;
+    D.setQuadCount(blk.code.size());
+    SymbolTable& syms = D.symbols();
+    for (auto&& var : blk.out)
+        out.set(syms.intern(var));
+    for (auto&& tri : blk.code)
+        D.readQuad(convert(tri, syms));
+    D.genOptimizedCode(out);
+    return { D.counters().nodesCreated, D.counters().quadsOut };
+}
+
+// 变异：替换、复制、交换四元式，插入赋值链与数组写，重用被赋值的名字，加长名字，修改出口活跃变量
+class Mutator
+{
+private:
+    WorkloadRandom rnd;
+    WorkloadGenerator donor;
+    size_t minQuads, maxQuads;
+
+    // 从合成的基本块中随机取一条非跳转语句
+    std::string randomQuad()
+    {
+        SyntheticBlock b = donor.next();
+        return b.code[rnd.below(b.code.size() - 1)];
+    }
+
+    // 语句中的名字（非常数、非运算符的记号）
+    static std::vector<std::string> names(const std::string& tri)
+    {
+        std::vector<std::string> result;
+        std::string token;
+        for (size_t k = 0; k <= tri.size(); ++k)
+        {
+            char c = k < tri.size() ? tri[k] : ' ';
+            if (c == ' ')
+            {
+                if (!token.empty() && (std::isalpha(static_cast<unsigned char>(token[0])) || token[0] == '_'))
+                    result.emplace_back(token);
+                token.clear();
+            }
+            else
+                token.push_back(c);
+        }
+        return result;
+    }
+
+    std::string anyName(const SyntheticBlock& blk)
+    {
+        for (int tries = 0; tries < 8; ++tries)
+        {
+            auto ns = names(blk.code[rnd.below(blk.code.size())]);
+            if (!ns.empty())
+                return ns[rnd.below(ns.size())];
+        }
+        return "v0";
+    }
+
+public:
+    Mutator(uint64_t seed, size_t minQuads, size_t maxQuads) : rnd(seed), donor([&]()
+        {
+            WorkloadSpec spec;
+            spec.seed = seed ^ 0x5bd1e995;
+            spec.minSize = 2;
+            spec.maxSize = 8;
+            spec.vars = 6;
+            spec.arrays = 2;
+            spec.arrayOps = 0.3;
+            return spec;
+        }()), minQuads(minQuads), maxQuads(maxQuads) {}
+
+    SyntheticBlock initial()
+    {
+        WorkloadSpec spec;
+        spec.seed = rnd.next();
+        spec.minSize = spec.maxSize = std::max<size_t>(minQuads, maxQuads / 2);
+        return WorkloadGenerator(spec).next();
+    }
+
+    void mutate(SyntheticBlock& blk)
+    {
+        // 最后一条是跳转语句，变异只作用于其前面的语句
+        std::string jump = blk.code.back();
+        blk.code.pop_back();
+        if (blk.code.empty())
+            blk.code.emplace_back(randomQuad());
+
+        auto& code = blk.code;
+        size_t k = rnd.below(code.size());
+        switch (rnd.below(9))
+        {
+            case 0:
+                code[k] = randomQuad();
+                break;
+            case 1:
+                code.insert(code.begin() + rnd.below(code.size() + 1), code[k]);
+                break;
+            case 2:
+                std::swap(code[k], code[rnd.below(code.size())]);
+                break;
+            case 3:
+                code.insert(code.begin() + k, anyName(blk) + " = " + anyName(blk));
+                break;
+            case 4:
+                code.insert(code.begin() + k, "A" + std::to_string(rnd.below(2)) + " [ " + anyName(blk) + " ] = " + anyName(blk));
+                break;
+            case 5:
+            {
+                // 覆盖一个已有的名字
+                auto ns = names(code[k]);
+                if (!ns.empty() && code[k].find(" = ") != std::string::npos && code[k].find(" [ ") == std::string::npos)
+                    code[k] = anyName(blk) + code[k].substr(code[k].find(" = "));
+                break;
+            }
+            case 6:
+            {
+                // 加长一个名字，所有出现处一并替换
+                std::string from = anyName(blk), to = from + from;
+                if (to.size() > 256)
+                    break;
+                for (auto&& line : code)
+                {
+                    std::string s = " " + line + " ";
+                    for (size_t p = 0; (p = s.find(" " + from + " ", p)) != std::string::npos; p += to.size() + 1)
+                        s.replace(p + 1, from.size(), to);
+                    line = s.substr(1, s.size() - 2);
+                }
+                for (auto&& o : blk.out)
+                    if (o == from)
+                        o = to;
+                break;
+            }
+            case 7:
+                if (!blk.out.empty() && rnd.chance(0.5))
+                    blk.out.erase(blk.out.begin() + rnd.below(blk.out.size()));
+                else
+                    blk.out.emplace_back(anyName(blk));
+                break;
+            default:
+                code.erase(code.begin() + k);
+                break;
+        }
+
+        while (code.size() + 1 > maxQuads && !code.empty())
+            code.erase(code.begin() + rnd.below(code.size()));
+        while (code.size() + 1 < minQuads)
+            code.insert(code.begin() + rnd.below(code.size() + 1), randomQuad());
+        code.emplace_back(jump);
+    }
+};
+
+// 逐条删除四元式，只要每个四元式的耗时不低于原来的 90% 就保留删除，至少保留 minQuads 条
+Candidate minimize(Candidate c, bool withConvert, size_t minQuads)
+{
+    double target = c.cost * 0.9;
+    for (size_t k = c.blk.code.size() - 1; k-- > 0 && c.blk.code.size() > minQuads;)
+    {
+        SyntheticBlock trial = c.blk;
+        trial.code.erase(trial.code.begin() + k);
+        double cost = measure(trial, withConvert);
+        if (cost >= target)
+        {
+            c.blk = std::move(trial);
+            c.cost = std::max(cost, c.cost);
+        }
+    }
+    return c;
+}
+
+int fuzz(const std::string& outfile, size_t iterations, size_t minQuads, size_t maxQuads, size_t keep,
+    uint64_t seed, bool withConvert)
+{
+    Mutator mut(seed, minQuads, maxQuads);
+    WorkloadRandom rnd(seed);
+    std::vector<Candidate> pool;
+
+    // 以保留数目的随机基本块为起点，每次变异池中的一个，比池中最好的差不多时替换池中最差的
+    while (pool.size() < keep)
+    {
+        Candidate c;
+        c.blk = mut.initial();
+        c.cost = measure(c.blk, withConvert);
+        pool.emplace_back(std::move(c));
+    }
+
+    auto worst = [&]()
+    {
+        size_t w = 0;
+        for (size_t k = 1; k < pool.size(); ++k)
+            if (pool[k].cost < pool[w].cost)
+                w = k;
+        return w;
+    };
+
+    for (size_t it = 0; it < iterations; ++it)
+    {
+        Candidate c;
+        c.blk = pool[rnd.below(pool.size())].blk;
+        size_t steps = 1 + rnd.below(3);
+        for (size_t s = 0; s < steps; ++s)
+            mut.mutate(c.blk);
+        c.cost = measure(c.blk, withConvert);
+
+        size_t w = worst();
+        if (c.cost > pool[w].cost)
+            pool[w] = std::move(c);
+
+        if ((it + 1) % 200 == 0)
+        {
+            double best = 0;
+            for (auto&& p : pool)
+                best = std::max(best, p.cost);
+            std::fprintf(stderr, "iteration %zu: worst-case %.1f ns/quad\n", it + 1, best);
+        }
+    }
+
+    // 化简后改以与参考基本块之比排序与记录
+    for (auto&& c : pool)
+    {
+        c = minimize(c, withConvert, minQuads);
+        c.cost = relativeCost(c.blk, withConvert);
+    }
+    std::sort(pool.begin(), pool.end(), [](const Candidate& a, const Candidate& b) { return a.cost > b.cost; });
+
+    json j;
+    j["summary"]["total_blocks"] = pool.size();
+    j["summary"]["objective"] = withConvert ? "all" : "dag";
+    for (size_t i = 0; i < pool.size(); ++i)
+    {
+        j["blocks"][std::to_string(i)]["code"] = pool[i].blk.code;
+        j["blocks"][std::to_string(i)]["out"] = pool[i].blk.out;
+        auto [nodes, quadsOut] = structuralCost(pool[i].blk);
+        j["summary"]["relative_cost"].push_back(pool[i].cost);
+        j["summary"]["nodes"].push_back(nodes);
+        j["summary"]["quads_out"].push_back(quadsOut);
+        std::printf("block %zu: %zu quads, %.2fx reference, %zu nodes, %zu quads out\n", i,
+            pool[i].blk.code.size(), pool[i].cost, nodes, quadsOut);
+    }
+    std::ofstream(outfile) << j.dump(4) << std::endl;
+    return 0;
+}
+
+// 重新测量保存的最坏情况，与记录的相对耗时及结构代价比较
+int replay(const std::string& file, double threshold)
+{
+    std::ifstream in(file);
+    if (!in)
+    {
+        std::cerr << "cannot open " << file << std::endl;
+        return 2;
+    }
+    json j;
+    in >> j;
+    if (!j["summary"].contains("relative_cost"))
+    {
+        std::cerr << file << " has no relative costs; regenerate it with this version of DAGFuzz" << std::endl;
+        return 2;
+    }
+    bool withConvert = j["summary"].value("objective", "dag") == "all";
+    size_t total = j["summary"]["total_blocks"];
+    bool ok = true;
+
+    std::printf("block  quads  recorded  current  ratio  nodes     quads out\n");
+    for (size_t i = 0; i < total; ++i)
+    {
+        SyntheticBlock blk;
+        blk.code = j["blocks"][std::to_string(i)]["code"].get<std::vector<std::string>>();
+        blk.out = j["blocks"][std::to_string(i)]["out"].get<std::vector<std::string>>();
+        double recorded = j["summary"]["relative_cost"][i];
+        size_t recordedNodes = j["summary"]["nodes"][i], recordedOut = j["summary"]["quads_out"][i];
+        double cost = relativeCost(blk, withConvert);
+        auto [nodes, quadsOut] = structuralCost(blk);
+        bool slower = cost > recorded * (1 + threshold);
+        bool more = nodes > recordedNodes || quadsOut > recordedOut;
+        ok = ok && !slower && !more;
+        std::printf("%-6zu %-6zu %-9.2f %-8.2f %.2fx  %3zu/%-3zu   %3zu/%-3zu%s%s\n", i, blk.code.size(), recorded, cost,
+            cost / recorded, nodes, recordedNodes, quadsOut, recordedOut, slower ? "  SLOWER" : "", more ? "  MORE WORK" : "");
+    }
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 2 && std::string(argv[1]) == "replay")
+        return replay(argv[2], argc > 3 ? std::stod(argv[3]) : 0.5);
+
+    std::string outfile = "worst_cases.json";
+    size_t iterations = 2000, minQuads = 16, maxQuads = 64, keep = 8;
+    uint64_t seed = 1;
+    bool withConvert = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+
+        if (key == "--out")
+            outfile = value;
+        else if (key == "--iterations")
+            iterations = std::stoull(value);
+        else if (key == "--min-quads")
+            minQuads = std::max<size_t>(2, std::stoull(value));
+        else if (key == "--max-quads")
+            maxQuads = std::max<size_t>(2, std::stoull(value));
+        else if (key == "--keep")
+            keep = std::max<size_t>(1, std::stoull(value));
+        else if (key == "--seed")
+            seed = std::stoull(value);
+        else if (key == "--objective")
+            withConvert = value == "all";
+        else
+        {
+            std::cerr << "unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    maxQuads = std::max(maxQuads, minQuads);
+    return fuzz(outfile, iterations, minQuads, maxQuads, keep, seed, withConvert);
+}
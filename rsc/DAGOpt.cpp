@@ -2,62 +2,178 @@
 #include <fstream>
 #include "DAG.hpp"
 #include "convert.hpp"
+#include "shard.hpp"
+#include "stats.hpp"
 #include "json.hpp"
 
 
 using json = nlohmann::json;
 
+// 四元式数不少于该值的基本块在构造 DAG 时使用哈希索引
+static size_t indexThreshold = DAG::DefaultIndexThreshold;
+
+// 是否在每个基本块中输出其优化效果计数
+static bool blockCounters = false;
+
+// 优化第 i 个基本块：以优化后的代码替换 blk["code"]，并将其 DAG 写入 DAGout
+void optimizeBlock(json& blk, size_t i, std::ostream& DAGout)
+{
+    // 每个线程复用同一个 DAG 工作区，避免每个基本块重新分配结点与临时容器
+    thread_local DAG D;
+    D.reset();
+    SymbolTable& syms = D.symbols();
+    runStats.beginBlock(i, blk["code"].size());
+
+    thread_local std::vector<QuadExp> quads;
+    thread_local SymbolBitset activeVars;
+    quads.clear();
+    activeVars.reset(0);
+    {
+        PhaseTimer timer(PH_CONVERT);
+        std::vector<std::string> codes = blk["code"], out = blk["out"];
+
+        for (auto&& var : out)
+            activeVars.set(syms.intern(strip(strip(var, '"'), ' ')));
+
+        for (auto&& code : codes)
+            quads.emplace_back(convert(strip(strip(code, '"'), ' '), syms));
+    }
+
+    {
+        PhaseTimer timer(PH_BUILD);
+        D.setIndexThreshold(indexThreshold);
+        D.setQuadCount(quads.size());
+        for (auto&& E : quads)
+            D.readQuad(E);
+    }
+
+    const std::vector<QuadExp>* optcd;
+    {
+        PhaseTimer timer(PH_EMIT);
+        optcd = &D.genOptimizedCode(activeVars);
+    }
+
+    {
+        PhaseTimer timer(PH_PRINT);
+        blk["code"].clear();
+
+        for (size_t k = 0; k < optcd->size(); ++k)
+            blk["code"][k] = convert2tri((*optcd)[k], syms);
+
+
+        DAGout << "BLOCK" << i << ": " << std::endl;
+        DAGout << D.print_DAG();
+
+        DAGout << "**************************************************" << std::endl << std::endl;
+    }
+    runStats.endBlock();
+
+    runStats.addCounters(D.counters());
+    if (blockCounters)
+        blk["counters"] = countersJson(D.counters());
+}
+
 
 int main(int argc, char** argv)
 {
     std::string infilename = "quick_ext.json";
     std::string outfilename = "blkopt.json";
     std::string DAGfilename = "DAG.txt";
-    if (argc == 3)
+    std::string statsfilename;
+    std::string tracefilename;
+    bool perf = false;
+    bool allocStats = false;
+    size_t shards = 1;
+    size_t slowestN = 10;
+
+    // 用法: DAGOpt [blk.json result.json] [--shards=N] [--index-threshold=N] [--stats[=stats.json]] [--stats-top=N] [--block-counters] [--trace=trace.json] [--perf] [--alloc-stats]
+    std::vector<std::string> positional;
+    for (int k = 1; k < argc; ++k)
     {
-        infilename  = std::string{ argv[1] };
-        outfilename = std::string{ argv[2] };
+        std::string arg{ argv[k] };
+        if (startWith(arg, std::string{ "--shards=" }))
+            shards = std::stoul(arg.substr(9));
+        else if (startWith(arg, std::string{ "--index-threshold=" }))
+            indexThreshold = std::stoul(arg.substr(18));
+        else if (arg == "--stats")
+            statsfilename = "stats.json";
+        else if (startWith(arg, std::string{ "--stats=" }))
+            statsfilename = arg.substr(8);
+        else if (startWith(arg, std::string{ "--stats-top=" }))
+            slowestN = std::stoul(arg.substr(12));
+        else if (arg == "--block-counters")
+            blockCounters = true;
+        else if (arg == "--perf")
+            perf = true;
+        else if (arg == "--alloc-stats")
+            allocStats = true;
+        else if (startWith(arg, std::string{ "--trace=" }))
+            tracefilename = arg.substr(8);
+        else
+            positional.emplace_back(arg);
+    }
+    if (positional.size() == 2)
+    {
+        infilename  = positional[0];
+        outfilename = positional[1];
     }
 
-    std::ifstream jfile(infilename);
     std::ofstream jout(outfilename);
     std::ofstream DAGout(DAGfilename);
 
-    json j;
-    jfile >> j;
-    size_t total = j["summary"]["total_blocks"];
-
-
-    for (size_t i = 0; i < total; ++i)
+    // 硬件计数与堆分配统计随计时一同报告
+    if ((perf || allocStats) && statsfilename.empty())
+        statsfilename = "stats.json";
+    allocTracker.on = allocStats;
+    if (perf && !perfCounters.open())
+        std::cerr << "DAGOpt: hardware counters unavailable (" << perfCounters.lastError() << ")" << std::endl;
+    if (!statsfilename.empty())
+        runStats.enable(slowestN);
+    if (!tracefilename.empty() && !traceLog.enable(tracefilename, wallNow()))
+        std::cerr << "DAGOpt: cannot open " << tracefilename << std::endl;
+
+    // 全部基本块的优化效果计数写入 summary
+    auto finish = [](json& j)
     {
-        std::vector<std::string> codes = j["blocks"][std::to_string(i)]["code"], out = j["blocks"][std::to_string(i)]["out"];
-        std::vector<std::string> activeVars;
+        j["summary"]["optimization"] = countersJson(runStats.counters());
+    };
 
-        for (auto&& var : out)
-            activeVars.emplace_back(strip(strip(var, '"'), ' '));
-
-        DAG D;
-
-        for (auto&& code : codes)
+    if (shards > 1)
+    {
+        // 分片模式下父进程不解析整个输入，由各子进程读入自己的基本块
+        if (!runSharded(infilename, shards, outfilename, jout, DAGout, optimizeBlock, finish))
         {
-            QuadExp E = convert(strip(strip(code, '"'), ' '));
-            D.readQuad(E);
+            std::cerr << "DAGOpt: sharded run failed" << std::endl;
+            return 1;
         }
+    }
+    else
+    {
+        json j;
+        {
+            PhaseTimer timer(PH_LOAD);
+            std::ifstream jfile(infilename);
+            jfile >> j;
+        }
+        size_t total = j["summary"]["total_blocks"];
 
-        std::vector<QuadExp> optcd = D.genOptimizedCode(activeVars);
-        j["blocks"][std::to_string(i)]["code"].clear();
-
-        for (size_t k = 0; k < optcd.size(); ++k)
-            j["blocks"][std::to_string(i)]["code"][k] = convert2tri(optcd[k]);
-
-
-        DAGout << "BLOCK" << i << ": " << std::endl;
-        DAGout << D.print_DAG();
+        for (size_t i = 0; i < total; ++i)
+        {
+            BlockSpan span(i, total - i);
+            optimizeBlock(j["blocks"][std::to_string(i)], i, DAGout);
+        }
+        if (traceLog.enabled())
+            traceLog.counter("pending blocks", wallNow(), 0);
+        finish(j);
 
-        DAGout << "**************************************************" << std::endl << std::endl;
+        PhaseTimer timer(PH_DUMP);
+        jout << j.dump(4);
+        jout.flush();
     }
 
-    jout << j.dump(4);
+    if (runStats.enabled())
+        std::ofstream(statsfilename) << runStats.report().dump(4) << std::endl;
+    traceLog.close();
 
 
     return 0;
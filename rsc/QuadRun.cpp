@@ -0,0 +1,383 @@
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include "DAG.hpp"
+#include "convert.hpp"
+#include "interp.hpp"
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+// 对比执行原始与优化后的程序：统计动态执行的四元式数与数组读写次数，检查两者的执行结果是否一致
+// 编译：g++ -std=c++17 -O2 QuadRun.cpp -o QuadRun
+// 运行：./QuadRun blk.json [result.json] [选项]
+//   result.json 为 DAGOpt 对 blk.json 的输出；省略时在进程内优化 blk.json 中的基本块
+//   存在差异时返回 1
+// 选项：
+//   --runs=N        以不同的初值执行的次数，默认 8
+//   --seed=N        种子，默认 1，第 r 次执行使用 seed + r
+//   --max-blocks=N  每次执行最多执行的基本块数，默认 100000，用于截断死循环
+//   --show=N        最多列出的差异数，默认 10
+//   --report=文件   另外写出 JSON 报告
+//   --each-block    不沿执行路径，而是每个基本块都从以种子生成的入口状态各执行一次，
+//                   检查全部基本块，包括执行路径到达不了的
+//
+// 两个版本沿原始程序的执行路径同步执行：每到一个基本块，先在入口状态上执行优化后的版本并记下结果，
+// 撤销其写入后再执行原始版本，比较出口活跃变量、被写过的数组元素以及出口，之后从原始版本的结果继续。
+// 优化只保证出口活跃变量的值，若某块的 out 中没有列出后继块读取的变量，两个版本各自独立执行就会分叉，
+// 这样的差异不是优化的错误，因此不独立执行
+
+
+// 读入 j 中的全部基本块，名字驻留于 syms；无法解析的三地址代码为 OP_NONE，执行到时报错
+void loadProgram(json& j, SymbolTable& syms, QuadProgram& prog)
+{
+    size_t total = j["summary"]["total_blocks"];
+    prog.blocks.assign(total, {});
+    prog.outs.assign(total, {});
+    for (size_t i = 0; i < total; ++i)
+    {
+        json& blk = j["blocks"][std::to_string(i)];
+        std::vector<std::string> codes = blk["code"], out = blk["out"];
+        for (auto&& var : out)
+            prog.outs[i].emplace_back(syms.intern(strip(strip(var, '"'), ' ')));
+        for (auto&& code : codes)
+            prog.blocks[i].emplace_back(convert(strip(strip(code, '"'), ' '), syms));
+    }
+}
+
+// 在进程内优化 prog 的各基本块，与 DAGOpt 相同
+QuadProgram optimizeProgram(const QuadProgram& prog, SymbolTable& syms)
+{
+    DAG D;
+    SymbolBitset active;
+    QuadProgram result;
+    result.outs = prog.outs;
+    result.blocks.resize(prog.blocks.size());
+
+    for (size_t i = 0; i < prog.blocks.size(); ++i)
+    {
+        D.reset();
+        D.setQuadCount(prog.blocks[i].size());
+        SymbolTable& local = D.symbols();
+
+        active.reset(0);
+        for (auto&& id : prog.outs[i])
+            active.set(local.intern(syms.name(id)));
+        for (auto&& E : prog.blocks[i])
+            D.readQuad(convert(convert2tri(E, syms), local));
+
+        for (auto&& E : D.genOptimizedCode(active))
+            result.blocks[i].emplace_back(convert(convert2tri(E, local), syms));
+    }
+    return result;
+}
+
+// 出口的文本形式
+std::string exitText(const BlockExit& e)
+{
+    switch (e.kind)
+    {
+        case EXIT_NEXT:
+            return "next";
+        case EXIT_JUMP:
+            return "L" + std::to_string(e.target);
+        case EXIT_HALT:
+            return "HALT";
+        default:
+            return std::string("fault at quad ") + std::to_string(e.at) + " (" + e.fault + ")";
+    }
+}
+
+// 同步执行的结果
+struct RunResult
+{
+    ExecCounts original, optimized;
+    size_t runs = 0;
+    size_t truncated = 0;       // 达到 --max-blocks 而截断的执行次数
+    size_t faults = 0;          // 原始程序无法继续执行的次数
+    size_t differences = 0;
+    std::vector<bool> differs;  // 各基本块是否出现过差异
+    std::vector<std::string> shown;
+
+    size_t differingBlocks() const
+    {
+        return size_t(std::count(differs.begin(), differs.end(), true));
+    }
+};
+
+class LockstepRunner
+{
+private:
+    const QuadProgram& orig;
+    const QuadProgram& opt;
+    const SymbolTable& syms;
+    QuadMachine machine;
+    size_t show;
+    RunResult& result;
+
+    // 优化后的版本写过的数组元素及其写后的值
+    std::unordered_map<ArrayCell, int64_t, ArrayCellHash> optCells;
+    std::vector<int64_t> optOuts;
+
+    void report(size_t run, size_t block, uint64_t step, const std::string& what)
+    {
+        ++result.differences;
+        result.differs[block] = true;
+        if (result.shown.size() < show)
+            result.shown.emplace_back("run " + std::to_string(run) + ", block " + std::to_string(block)
+                + " (step " + std::to_string(step) + "): " + what);
+    }
+
+    std::string cellText(const ArrayCell& c) const
+    {
+        return syms.name(c.array) + "[" + std::to_string(c.index) + "]";
+    }
+
+public:
+    LockstepRunner(const QuadProgram& orig, const QuadProgram& opt, const SymbolTable& syms, size_t show, RunResult& result)
+        : orig(orig), opt(opt), syms(syms), machine(syms, orig.blocks.size()), show(show), result(result)
+    {
+        result.differs.assign(orig.blocks.size(), false);
+    }
+
+    // 在当前状态上先后执行第 b 个基本块的两个版本并比较，返回原始版本的出口；
+    // 之后的状态为原始版本执行后的状态，其写入仍记录在日志中
+    BlockExit compare(size_t run, size_t b, uint64_t step)
+    {
+        // 优化后的版本：记下出口活跃变量与写过的数组元素，然后撤销
+        machine.clearLog();
+        BlockExit optExit = machine.run(opt.blocks[b], result.optimized);
+        optOuts.clear();
+        for (auto&& id : orig.outs[b])
+            optOuts.emplace_back(machine.variable(id));
+        optCells.clear();
+        for (auto&& w : machine.writtenCells())
+            optCells[w.first] = machine.load(w.first);
+        machine.rollback();
+
+        // 原始版本
+        BlockExit origExit = machine.run(orig.blocks[b], result.original);
+
+        if (origExit.kind == EXIT_FAULT)
+        {
+            ++result.faults;
+            if (result.faults == 1)
+                std::cerr << "QuadRun: original block " << b << " " << exitText(origExit) << std::endl;
+            return origExit;
+        }
+        if (optExit != origExit || optExit.kind == EXIT_FAULT)
+            report(run, b, step, "exit: original " + exitText(origExit) + ", optimized " + exitText(optExit));
+        for (size_t k = 0; k < orig.outs[b].size(); ++k)
+        {
+            uint32_t id = orig.outs[b][k];
+            if (machine.variable(id) != optOuts[k])
+                report(run, b, step, syms.name(id) + ": original " + std::to_string(machine.variable(id))
+                    + ", optimized " + std::to_string(optOuts[k]));
+        }
+        for (auto&& c : optCells)
+        {
+            if (machine.load(c.first) != c.second)
+                report(run, b, step, cellText(c.first) + ": original " + std::to_string(machine.load(c.first))
+                    + ", optimized " + std::to_string(c.second));
+        }
+        // 只被原始版本写过的元素在优化后的版本中保持入口的值，即第一次写入前的旧值
+        for (auto&& w : machine.writtenCells())
+        {
+            if (optCells.count(w.first))
+                continue;
+            optCells.emplace(w.first, w.second);
+            if (machine.load(w.first) != w.second)
+                report(run, b, step, cellText(w.first) + ": original " + std::to_string(machine.load(w.first))
+                    + ", optimized " + std::to_string(w.second));
+        }
+        return origExit;
+    }
+
+    // 以种子 seed 沿原始程序的执行路径执行一次，最多执行 maxBlocks 个基本块
+    void run(size_t index, uint64_t seed, uint64_t maxBlocks)
+    {
+        ++result.runs;
+        machine.reset(seed);
+        size_t b = 0;
+        uint64_t step = 0;
+
+        while (b < orig.blocks.size())
+        {
+            if (step == maxBlocks)
+            {
+                ++result.truncated;
+                return;
+            }
+
+            BlockExit exit = compare(index, b, step);
+            machine.clearLog();
+            if (exit.kind == EXIT_FAULT || exit.kind == EXIT_HALT)
+                return;
+
+            ++step;
+            b = exit.kind == EXIT_JUMP ? size_t(exit.target) : b + 1;
+        }
+    }
+
+    // 以种子 seed 生成入口状态，每个基本块都从该状态执行一次
+    void runEach(size_t index, uint64_t seed)
+    {
+        ++result.runs;
+        machine.reset(seed);
+        for (size_t b = 0; b < orig.blocks.size(); ++b)
+        {
+            compare(index, b, 0);
+            machine.rollback();
+        }
+    }
+};
+
+json countsJson(const ExecCounts& c)
+{
+    json j;
+    j["blocks"] = c.blocks;
+    j["instructions"] = c.instructions;
+    j["loads"] = c.loads;
+    j["stores"] = c.stores;
+    j["array_traffic"] = c.loads + c.stores;
+    j["branches"] = c.branches;
+    j["taken"] = c.taken;
+    return j;
+}
+
+double ratio(uint64_t a, uint64_t b)
+{
+    return b == 0 ? 0.0 : double(a) / double(b);
+}
+
+int main(int argc, char** argv)
+{
+    size_t runs = 8, show = 10;
+    uint64_t seed = 1, maxBlocks = 100000;
+    bool eachBlock = false;
+    std::string reportfile;
+    std::vector<std::string> positional;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+
+        if (key == "--runs")
+            runs = std::stoull(value);
+        else if (key == "--seed")
+            seed = std::stoull(value);
+        else if (key == "--max-blocks")
+            maxBlocks = std::max<uint64_t>(1, std::stoull(value));
+        else if (key == "--show")
+            show = std::stoull(value);
+        else if (key == "--report")
+            reportfile = value;
+        else if (arg == "--each-block")
+            eachBlock = true;
+        else if (startWith(arg, std::string{ "--" }))
+        {
+            std::cerr << "unknown option: " << arg << std::endl;
+            return 1;
+        }
+        else
+            positional.emplace_back(arg);
+    }
+    if (positional.empty() || positional.size() > 2)
+    {
+        std::cerr << "usage: QuadRun blk.json [result.json] [--runs=N] [--seed=N] [--max-blocks=N] [--show=N] [--report=file] [--each-block]" << std::endl;
+        return 1;
+    }
+
+    SymbolTable syms;
+    QuadProgram orig, opt;
+    {
+        std::ifstream in(positional[0]);
+        if (!in)
+        {
+            std::cerr << "QuadRun: cannot open " << positional[0] << std::endl;
+            return 1;
+        }
+        json j;
+        in >> j;
+        loadProgram(j, syms, orig);
+    }
+    if (positional.size() == 2)
+    {
+        std::ifstream in(positional[1]);
+        if (!in)
+        {
+            std::cerr << "QuadRun: cannot open " << positional[1] << std::endl;
+            return 1;
+        }
+        json j;
+        in >> j;
+        loadProgram(j, syms, opt);
+        if (opt.blocks.size() != orig.blocks.size())
+        {
+            std::cerr << "QuadRun: " << positional[1] << " has " << opt.blocks.size() << " blocks, expected "
+                << orig.blocks.size() << std::endl;
+            return 1;
+        }
+    }
+    else
+        opt = optimizeProgram(orig, syms);
+
+    RunResult result;
+    LockstepRunner runner(orig, opt, syms, show, result);
+    for (size_t r = 0; r < runs; ++r)
+    {
+        if (eachBlock)
+            runner.runEach(r, seed + r);
+        else
+            runner.run(r, seed + r, maxBlocks);
+    }
+
+    const ExecCounts& a = result.original;
+    const ExecCounts& b = result.optimized;
+    std::printf("runs %zu, blocks executed %llu", result.runs, (unsigned long long)a.blocks);
+    if (result.truncated)
+        std::printf(", %zu truncated at %llu blocks", result.truncated, (unsigned long long)maxBlocks);
+    if (result.faults)
+        std::printf(", %zu stopped by a fault in the original", result.faults);
+    std::printf("\n\n%-14s %-14s %-14s %s\n", "", "original", "optimized", "ratio");
+    auto row = [](const char* name, uint64_t x, uint64_t y)
+    {
+        std::printf("%-14s %-14llu %-14llu %.3f\n", name, (unsigned long long)x, (unsigned long long)y, ratio(y, x));
+    };
+    row("instructions", a.instructions, b.instructions);
+    row("loads", a.loads, b.loads);
+    row("stores", a.stores, b.stores);
+    row("array traffic", a.loads + a.stores, b.loads + b.stores);
+    row("branches", a.branches, b.branches);
+    std::printf("\nspeedup %.3fx in executed instructions\n", ratio(a.instructions, b.instructions));
+
+    std::printf("differences %zu in %zu blocks\n", result.differences, result.differingBlocks());
+    for (auto&& s : result.shown)
+        std::printf("  %s\n", s.c_str());
+    if (result.differences > result.shown.size())
+        std::printf("  ...\n");
+
+    if (!reportfile.empty())
+    {
+        json j;
+        j["runs"] = result.runs;
+        j["seed"] = seed;
+        j["max_blocks"] = maxBlocks;
+        j["truncated"] = result.truncated;
+        j["faults"] = result.faults;
+        j["original"] = countsJson(a);
+        j["optimized"] = countsJson(b);
+        j["instruction_ratio"] = ratio(b.instructions, a.instructions);
+        j["array_traffic_ratio"] = ratio(b.loads + b.stores, a.loads + a.stores);
+        j["mode"] = eachBlock ? "each-block" : "path";
+        j["differences"] = result.differences;
+        j["differing_blocks"] = result.differingBlocks();
+        j["first_differences"] = result.shown;
+        std::ofstream(reportfile) << j.dump(4) << std::endl;
+    }
+
+    return result.differences == 0 ? 0 : 1;
+}
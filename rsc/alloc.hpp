@@ -0,0 +1,112 @@
+#ifndef __ALLOC_HPP__
+#define __ALLOC_HPP__
+
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#ifdef __APPLE__
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+// 堆分配统计
+// 替换全局的 operator new / delete，直接使用 malloc / free，不附加头部；启用后累计分配次数与字节数，
+// 并按 malloc 实际占用的大小记录当前占用与峰值，释放时的大小同样向 malloc 查询，
+// 各阶段的分配由 PhaseTimer 取其前后之差得到
+// 只应由一个可执行文件的一个翻译单元包含
+
+struct AllocTracker
+{
+    bool on = false;
+    uint64_t count = 0;         // 累计分配次数
+    uint64_t bytes = 0;         // 累计请求的字节数
+    uint64_t live = 0;          // 当前占用的字节数
+    uint64_t peak = 0;          // live 的峰值，可由调用者重置以统计一段时间内的峰值
+};
+
+static AllocTracker allocTracker;
+
+// malloc 为 p 实际分配的字节数
+inline size_t allocatedSize(void* p)
+{
+#if defined(_WIN32)
+    return _msize(p);
+#elif defined(__APPLE__)
+    return malloc_size(p);
+#else
+    return malloc_usable_size(p);
+#endif
+}
+
+void* trackedAllocate(size_t size)
+{
+    void* p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    if (allocTracker.on)
+    {
+        ++allocTracker.count;
+        allocTracker.bytes += size;
+        allocTracker.live += allocatedSize(p);
+        if (allocTracker.live > allocTracker.peak)
+            allocTracker.peak = allocTracker.live;
+    }
+    return p;
+}
+
+void trackedRelease(void* p) noexcept
+{
+    if (!p)
+        return;
+    if (allocTracker.on)
+    {
+        // 启用统计之前分配的块也会在这里释放，当前占用不低于 0
+        size_t n = allocatedSize(p);
+        allocTracker.live = allocTracker.live > n ? allocTracker.live - n : 0;
+    }
+    std::free(p);
+}
+
+void* operator new(size_t size)
+{
+    return trackedAllocate(size);
+}
+void* operator new[](size_t size)
+{
+    return trackedAllocate(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    try { return trackedAllocate(size); } catch (...) { return nullptr; }
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    try { return trackedAllocate(size); } catch (...) { return nullptr; }
+}
+void operator delete(void* p) noexcept
+{
+    trackedRelease(p);
+}
+void operator delete[](void* p) noexcept
+{
+    trackedRelease(p);
+}
+void operator delete(void* p, size_t) noexcept
+{
+    trackedRelease(p);
+}
+void operator delete[](void* p, size_t) noexcept
+{
+    trackedRelease(p);
+}
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    trackedRelease(p);
+}
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+    trackedRelease(p);
+}
+
+#endif
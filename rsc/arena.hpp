@@ -0,0 +1,87 @@
+#ifndef __ARENA_HPP__
+#define __ARENA_HPP__
+
+#include <memory_resource>
+#include <optional>
+#include <cstddef>
+#include <vector>
+
+// 基本块级别的单调分配器
+// 处理一个基本块时的所有临时容器都从 resource() 分配，块处理结束后由 release() 一次性回收。
+// 若某个块用尽了预留缓冲区，release() 时按溢出量扩大缓冲区，稳定状态下不再向系统申请内存
+class BlockArena
+{
+private:
+    // 记录单调分配器向上游申请的字节数
+    struct CountingResource : std::pmr::memory_resource
+    {
+        size_t bytes = 0;
+
+        void* do_allocate(size_t bytes, size_t align) override
+        {
+            this->bytes += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, align);
+        }
+
+        void do_deallocate(void* p, size_t bytes, size_t align) override
+        {
+            std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+    };
+
+    std::vector<std::byte> buffer;
+    CountingResource upstream;
+    std::optional<std::pmr::monotonic_buffer_resource> mono;
+
+    void rebuild()
+    {
+        if (buffer.empty())
+            mono.emplace(&upstream);
+        else
+            mono.emplace(buffer.data(), buffer.size(), &upstream);
+    }
+
+public:
+    explicit BlockArena(size_t initialBytes = 0) : buffer(initialBytes)
+    {
+        rebuild();
+    }
+
+    BlockArena(const BlockArena&) = delete;
+    BlockArena& operator=(const BlockArena&) = delete;
+
+    std::pmr::memory_resource* resource()
+    {
+        return &*mono;
+    }
+
+    // 回收本块的所有临时内存
+    void release()
+    {
+        mono->release();
+        if (upstream.bytes != 0)
+        {
+            mono.reset();
+            buffer.resize(buffer.size() + upstream.bytes);
+            upstream.bytes = 0;
+            rebuild();
+        }
+    }
+
+    // 回收所有内存，包括预留的缓冲区
+    void shrink()
+    {
+        mono.reset();
+        buffer.clear();
+        buffer.shrink_to_fit();
+        upstream.bytes = 0;
+        rebuild();
+    }
+};
+
+#endif
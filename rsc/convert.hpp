@@ -1,106 +1,157 @@
 #ifndef __CONVERT_HPP__
 #define __CONVERT_HPP__
+#include <charconv>
 #include "global.hpp"
 
 // 完成三地址代码和四元式的解析和相互转换
-// 如 (ADD, X, A, B)  <---> "X = A + B" 
+// 如 (ADD, X, A, B)  <---> "X = A + B"
+// 四元式中的名字均驻留于 syms，只有此处与文本打交道
 
-QuadExp convertSET(const std::cmatch& m)
+// 将常数编码为操作数：0 ~ 2^32-1 之间的常数直接内联，其余存入常数池
+Operand makeLiteral(int64_t value, SymbolTable& syms)
+{
+    if (value >= 0 && value <= 0xffffffffll)
+        return Operand{ OPD_IMM, uint32_t(value) };
+    return Operand{ OPD_LIT, syms.internLiteral(value) };
+}
+
+// 将操作数文本编码为操作数
+// 常数只在此处解析一次；超出 64 位范围的数字串无法参与计算，与名字一样按文本驻留
+// 常数折叠可能生成负数，因此也接受带负号的常数，以便优化后的代码能被重新读入
+Operand makeOperand(const std::string& text, SymbolTable& syms)
+{
+    size_t sign = (!text.empty() && text[0] == '-') ? 1 : 0;
+    if (text.size() > sign && isLiteral(text.substr(sign)))
+    {
+        int64_t value = 0;
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (ec == std::errc() && ptr == text.data() + text.size())
+            return makeLiteral(value, syms);
+    }
+    return Operand::name(syms.intern(text));
+}
+
+// 返回常数的文本形式
+std::string literalText(int64_t value)
+{
+    char buf[24];
+    char* end = std::to_chars(buf, buf + sizeof(buf), value).ptr;
+    return std::string(buf, end);
+}
+
+// 返回操作数的文本形式
+std::string operandText(const Operand& arg, const SymbolTable& syms)
+{
+    switch (arg.kind)
+    {
+        case OPD_NAME:
+            return syms.name(arg.id);
+        case OPD_IMM:
+            return literalText(arg.id);
+        case OPD_LIT:
+            return literalText(syms.literal(arg.id));
+        case OPD_OP:
+            return opNames[arg.id];
+        default:
+            return "-";
+    }
+}
+
+QuadExp convertSET(const std::cmatch& m, SymbolTable& syms)
 {
     QuadExp result;
-    result.op = "SET";
-    result.a1 = m[1].str();
-    result.a2 = m[2].str();
-    result.a3 = "-";
+    result.op = OP_SET;
+    result.setOperand(1, Operand::name(syms.intern(m[1].str())));
+    result.setOperand(2, makeOperand(m[2].str(), syms));
 
     return result;
 }
 
-QuadExp convertART(const std::cmatch& m)
+QuadExp convertART(const std::cmatch& m, SymbolTable& syms)
 {
-    static std::map<std::string, std::string> opt = {
-        {"+", "ADD"}, {"-", "SUB"},
-        {"*", "MUL"}, {"/", "DIV"},
-        {"%", "MOD"}
+    static std::map<std::string, Opcode> opt = {
+        {"+", OP_ADD}, {"-", OP_SUB},
+        {"*", OP_MUL}, {"/", OP_DIV},
+        {"%", OP_MOD}
     };
 
     QuadExp result;
     result.op = opt[m[3]];
-    result.a1 = m[1].str();
-    result.a2 = m[2].str();
-    result.a3 = m[4].str();
+    result.setOperand(1, Operand::name(syms.intern(m[1].str())));
+    result.setOperand(2, makeOperand(m[2].str(), syms));
+    result.setOperand(3, makeOperand(m[4].str(), syms));
 
     return result;
 }
 
-QuadExp convertFAR(const std::cmatch& m)
+QuadExp convertFAR(const std::cmatch& m, SymbolTable& syms)
 {
     QuadExp result;
-    result.op = "FAR";
-    result.a1 = m[1].str();
-    result.a2 = m[2].str();
-    result.a3 = m[3].str();
+    result.op = OP_FAR;
+    result.setOperand(1, Operand::name(syms.intern(m[1].str())));
+    result.setOperand(2, makeOperand(m[2].str(), syms));
+    result.setOperand(3, makeOperand(m[3].str(), syms));
 
     return result;
 }
 
-QuadExp convertTAR(const std::cmatch& m)
+QuadExp convertTAR(const std::cmatch& m, SymbolTable& syms)
 {
     QuadExp result;
-    result.op = "TAR";
-    result.a1 = m[1].str();
-    result.a2 = m[2].str();
-    result.a3 = m[3].str();
+    result.op = OP_TAR;
+    result.setOperand(1, makeOperand(m[1].str(), syms));
+    result.setOperand(2, makeOperand(m[2].str(), syms));
+    result.setOperand(3, makeOperand(m[3].str(), syms));
 
     return result;
 }
 
-QuadExp convertJMP(const std::cmatch& m)
+QuadExp convertJMP(const std::cmatch& m, SymbolTable& syms)
 {
     QuadExp result;
-    result.op = "JMP";
-    result.a1 = m[1].str();
-    result.a2 = "-";
-    result.a3 = "-";
+    result.op = OP_JMP;
+    result.setOperand(1, Operand::name(syms.intern(m[1].str())));
 
     return result;
 }
 
-QuadExp convertJOP(const std::cmatch& m)
+QuadExp convertJOP(const std::cmatch& m, SymbolTable& syms)
 {
-    static std::map<std::string, std::string> opt = {
-        {">", "JGT"}, {">=", "JGE"},
-        {"<", "JLT"}, {"<=", "JLE"},
-        {"==", "JEQ"}, {"!=", "JNE"}
+    static std::map<std::string, Opcode> opt = {
+        {">", OP_JGT}, {">=", OP_JGE},
+        {"<", OP_JLT}, {"<=", OP_JLE},
+        {"==", OP_JEQ}, {"!=", OP_JNE}
     };
 
     QuadExp result;
     result.op = opt[m[2]];
-    result.a1 = m[4].str();
-    result.a2 = m[1].str();
-    result.a3 = m[3].str();
+    result.setOperand(1, Operand::name(syms.intern(m[4].str())));
+    result.setOperand(2, makeOperand(m[1].str(), syms));
+    result.setOperand(3, makeOperand(m[3].str(), syms));
 
     return result;
 }
 
 // 正则解析规则与匹配后对应的操作
-static std::vector<std::pair<std::regex, std::function<QuadExp(const std::cmatch&)>>> expRules = 
+// 常数折叠可能生成负数，因此取值的操作数也接受带负号的常数，以便优化后的代码能被重新读入
+using ConvertRule = std::function<QuadExp(const std::cmatch&, SymbolTable&)>;
+static std::vector<std::pair<std::regex, ConvertRule>> expRules =
 {
-    {std::regex("(\\w*)\\s[=]\\s(\\w*)"), std::function<QuadExp(const std::cmatch&)>(convertSET)},
-    {std::regex("(\\w*)\\s[=]\\s(\\w*)\\s([\\+\\-\\*\\/\\%])\\s(\\w*)"), std::function<QuadExp(const std::cmatch&)>(convertART)},
-    {std::regex("(\\w*)\\s[=]\\s(\\w*)\\s\\[\\s(\\w*)\\s\\]"), std::function<QuadExp(const std::cmatch&)>(convertFAR)},
-    {std::regex("(\\w*)\\s\\[\\s(\\w*)\\s\\]\\s[=]\\s(\\w*)"), std::function<QuadExp(const std::cmatch&)>(convertTAR)},
-    {std::regex("!:\\s(\\w*)"), std::function<QuadExp(const std::cmatch&)>(convertJMP)},
-    {std::regex("\\?\\s(\\w*)\\s(.*)\\s(\\w*)\\s:\\s(\\w*)"), std::function<QuadExp(const std::cmatch&)>(convertJOP)}
+    {std::regex("(\\w*)\\s[=]\\s(-?\\w*)"), ConvertRule(convertSET)},
+    {std::regex("(\\w*)\\s[=]\\s(-?\\w*)\\s([\\+\\-\\*\\/\\%])\\s(-?\\w*)"), ConvertRule(convertART)},
+    {std::regex("(\\w*)\\s[=]\\s(\\w*)\\s\\[\\s(-?\\w*)\\s\\]"), ConvertRule(convertFAR)},
+    {std::regex("(\\w*)\\s\\[\\s(-?\\w*)\\s\\]\\s[=]\\s(-?\\w*)"), ConvertRule(convertTAR)},
+    {std::regex("!:\\s(\\w*)"), ConvertRule(convertJMP)},
+    {std::regex("\\?\\s(-?\\w*)\\s(.*)\\s(-?\\w*)\\s:\\s(\\w*)"), ConvertRule(convertJOP)}
 };
 
-QuadExp convert(const std::string& tri)
+// 解析一条三地址代码，其中的名字驻留于 syms
+QuadExp convert(const std::string& tri, SymbolTable& syms)
 {
     QuadExp e;
     if(tri == "HALT")
     {
-        e.op = "HALT";
-        e.a1 = "-", e.a2 = "-", e.a3 = "-";
+        e.op = OP_HALT;
         return e;
     }
     std::cmatch m;
@@ -108,7 +159,7 @@ QuadExp convert(const std::string& tri)
     {
         if(std::regex_match(tri.c_str(), m, rule.first))
         {
-            e = rule.second(m);
+            e = rule.second(m, syms);
             break;
         }
     }
@@ -116,54 +167,44 @@ QuadExp convert(const std::string& tri)
 }
 
 
-std::string convert2tri(const QuadExp& e)
+std::string convert2tri(const QuadExp& e, const SymbolTable& syms)
 {
-    if (e.op == "HALT")
+    if (e.op == OP_HALT)
         return std::string{ "HALT" };
 
     std::string result;
-    std::map<std::string, std::string> opt = 
-    {
-        {"ADD", "+"}, {"SUB", "-"},
-        {"MUL", "*"}, {"DIV", "/"},
-        {"MOD", "%"}
-    };
-    std::map<std::string, std::string> rop = 
-    {
-        {"JGT", ">"}, {"JGE", ">="},
-        {"JLT", "<"}, {"JLE", "<="},
-        {"JEQ", "=="}, {"JNE", "!="}
-    };
+    static const char* const opt[] = { "+", "-", "*", "/", "%" };
+    static const char* const rop[] = { ">", ">=", "<", "<=", "==", "!=" };
+
+    std::string a1 = operandText(e.operand(1), syms);
+    std::string a2 = operandText(e.operand(2), syms);
+    std::string a3 = operandText(e.operand(3), syms);
 
     //(SET, A, X, -) => A = X
-    if(e.op == "SET")
-        result = e.a1 + " = " + e.a2;
-    
+    if(e.op == OP_SET)
+        result = a1 + " = " + a2;
+
     //(ADD, A, B, C) => A = B + C
-    else if(
-        e.op == "ADD" || e.op == "SUB" ||
-        e.op == "MUL" || e.op == "DIV" ||
-        e.op == "MOD"
-    )
-        result = e.a1 + " = " + e.a2 + " " + opt[e.op] + " " + e.a3;
-    
+    else if(e.op >= OP_ADD && e.op <= OP_MOD)
+        result = a1 + " = " + a2 + " " + opt[e.op - OP_ADD] + " " + a3;
+
     //(FAR, X, A, I) => X = A [ I ]
-    else if(e.op == "FAR")
-        result = e.a1 + " = " + e.a2 + " [ " + e.a3 + " ]";
-    
+    else if(e.op == OP_FAR)
+        result = a1 + " = " + a2 + " [ " + a3 + " ]";
+
     //(TAR, A, I, X) => A [ I ] = X
-    else if(e.op == "TAR")
-        result = e.a1 + " [ " + e.a2 + " ] = " + e.a3;
-    
+    else if(e.op == OP_TAR)
+        result = a1 + " [ " + a2 + " ] = " + a3;
+
     //(JMP, T, -, -) => !: T
-    else if(e.op == "JMP")
-        result = "!: " + e.a1;
+    else if(e.op == OP_JMP)
+        result = "!: " + a1;
 
     //(JGT, T, X, Y) => ? X > Y : T
-    else if(e.op[0] == 'J' && e.op != "JMP")
-        result = "? " + e.a2 + " " + rop[e.op] + " " + e.a3 + " : " + e.a1;
+    else if(isConditionalJump(e.op))
+        result = "? " + a2 + " " + rop[e.op - OP_JGT] + " " + a3 + " : " + a1;
 
     return result;
 }
 
-#endif
\ No newline at end of file
+#endif
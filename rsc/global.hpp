@@ -11,62 +11,247 @@
 #include <stack>
 #include <tuple>
 #include <memory>
+#include <memory_resource>
 #include <regex>
 #include <functional>
+#include <cstdint>
+#include <type_traits>
 #include <assert.h>
+#include "symtab.hpp"
 
 
+// 操作码
+enum Opcode : uint8_t
+{
+    OP_NONE,
+    OP_SET,
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD,
+    OP_FAR, OP_TAR,
+    OP_JMP,
+    OP_JGT, OP_JGE, OP_JLT, OP_JLE, OP_JEQ, OP_JNE,
+    OP_HALT
+};
+
+// 操作码的文本形式
+static const char* const opNames[] = {
+    "",
+    "SET",
+    "ADD", "SUB", "MUL", "DIV", "MOD",
+    "FAR", "TAR",
+    "JMP",
+    "JGT", "JGE", "JLT", "JLE", "JEQ", "JNE",
+    "HALT"
+};
+
+// 判断 op 是否是条件跳转
+bool isConditionalJump(uint8_t op)
+{
+    return op >= OP_JGT && op <= OP_JNE;
+}
+
+// 操作数的种类
+enum OperandKind : uint8_t
+{
+    OPD_NONE,   // 空操作数 "-"
+    OPD_NAME,   // 驻留的名字，id 为 SymbolTable 中的编号
+    OPD_IMM,    // 内联的常数 (0 ~ 2^32-1)，id 即为常数值
+    OPD_LIT,    // 其余的 64 位常数，id 为其在常数池中的编号
+    OPD_OP      // 运算符，仅用作 DAG 内部结点的值，id 为操作码
+};
+
+// 操作数：名字的编号或常数
+// 每个常数只有一种编码，因此两个操作数相等当且仅当它们表示同一个名字或同一个值
+struct Operand
+{
+    uint8_t kind = OPD_NONE;
+    uint32_t id = 0;
+
+    static Operand name(uint32_t id)
+    {
+        return Operand{ OPD_NAME, id };
+    }
+
+    static Operand op(uint8_t opcode)
+    {
+        return Operand{ OPD_OP, opcode };
+    }
+
+    bool operator==(const Operand& other) const
+    {
+        return kind == other.kind && id == other.id;
+    }
+
+    bool operator!=(const Operand& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+// 判断操作数是否是常数
+bool isLiteral(const Operand& arg)
+{
+    return arg.kind == OPD_IMM || arg.kind == OPD_LIT;
+}
+
 // 四元式的定义
+// 紧凑的 16 字节表示：操作码、三个操作数的种类及三个 32 位操作数编号，
+// 与三地址代码文本之间的转换见 convert.hpp
 struct QuadExp
 {
-    std::string op, a1, a2, a3;
+    uint8_t op = OP_NONE;
+    uint8_t kinds = 0;      // 第 k 个操作数的种类位于 [2k-2, 2k) 位
+    uint16_t reserved = 0;
+    uint32_t a1 = 0, a2 = 0, a3 = 0;
 
-    QuadExp(const std::string& op = "", const std::string& a1 = "", const std::string& a2 = "", const std::string& a3 = "")
+    QuadExp(uint8_t op = OP_NONE, Operand a1 = {}, Operand a2 = {}, Operand a3 = {})
     {
         this->op = op;
-        this->a1 = a1;
-        this->a2 = a2;
-        this->a3 = a3;
+        setOperand(1, a1);
+        setOperand(2, a2);
+        setOperand(3, a3);
+    }
+
+    // 返回第 k (1 ~ 3) 个操作数
+    Operand operand(int k) const
+    {
+        uint8_t kind = (kinds >> (2 * (k - 1))) & 3;
+        uint32_t id = (k == 1 ? a1 : k == 2 ? a2 : a3);
+        return Operand{ kind, id };
+    }
+
+    void setOperand(int k, Operand arg)
+    {
+        assert(arg.kind <= OPD_LIT);
+        kinds = uint8_t((kinds & ~(3 << (2 * (k - 1)))) | (arg.kind << (2 * (k - 1))));
+        (k == 1 ? a1 : k == 2 ? a2 : a3) = arg.id;
     }
 
     // 返回四元式的类型
     int type()  const
     {
-        if (op == "SET")
+        if (op == OP_SET)
             return 0;
-        if (op == "TAR")
+        if (op == OP_TAR)
             return 3;
 
         // 1 型四元式暂未被使用
-        if (a2 == "-" && a3 != "-")
+        if (operand(2).kind == OPD_NONE && operand(3).kind != OPD_NONE)
             return 1;
 
         return 2;
     }
 
-    std::string toString()
-    {
-        return (op + "\t" + a1 + "\t" + a2 + "\t" + a3 + "\t");
-    }
-
     void clear()
     {
-        op.clear();
-        a1.clear();
-        a2.clear();
-        a3.clear();
+        *this = QuadExp{};
     }
 };
 
-std::istream& operator>>(std::istream& in, QuadExp& E)
-{
-    in >> E.op >> E.a1 >> E.a2 >> E.a3;
-    return in;
-};
-std::ostream& operator<<(std::ostream& out, const QuadExp& E)
+static_assert(sizeof(QuadExp) == 16, "QuadExp should stay 16 bytes");
+
+// 小向量：前 N 个元素存放在对象内部，超出后才转移到堆上
+// 仅用于可平凡复制的元素类型（如标识符编号）；clear() 保留已分配的堆空间
+template<typename T, size_t N>
+class SmallVector
 {
-    out << E.op << "\t" << E.a1 << "\t" << E.a2 << "\t" << E.a3 << " \n";
-    return out;
+    static_assert(std::is_trivially_copyable<T>::value, "SmallVector only holds trivially copyable types");
+
+private:
+    uint32_t count = 0;
+    uint32_t cap = N;
+    union
+    {
+        T local[N];
+        T* heap;
+    };
+
+    T* data()
+    {
+        return cap == N ? local : heap;
+    }
+
+    const T* data() const
+    {
+        return cap == N ? local : heap;
+    }
+
+    void grow()
+    {
+        // 只在 count == cap 时扩容；内部与堆上的缓冲区分开复制，复制的来源与长度都是确定的
+        size_t newCap = size_t(cap) * 2;
+        T* p = new T[newCap];
+        if (cap == N)
+            std::copy(local, local + N, p);
+        else
+        {
+            std::copy(heap, heap + cap, p);
+            delete[] heap;
+        }
+        heap = p;
+        cap = uint32_t(newCap);
+    }
+
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    SmallVector() {}
+
+    SmallVector(const SmallVector& other)
+    {
+        for (auto&& e : other)
+            push_back(e);
+    }
+
+    SmallVector& operator=(const SmallVector& other)
+    {
+        if (this != &other)
+        {
+            clear();
+            for (auto&& e : other)
+                push_back(e);
+        }
+        return *this;
+    }
+
+    ~SmallVector()
+    {
+        if (cap != N)
+            delete[] heap;
+    }
+
+    iterator begin() { return data(); }
+    iterator end() { return data() + count; }
+    const_iterator begin() const { return data(); }
+    const_iterator end() const { return data() + count; }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    void clear() { count = 0; }
+
+    T& operator[](size_t i) { return data()[i]; }
+    const T& operator[](size_t i) const { return data()[i]; }
+
+    void push_back(const T& e)
+    {
+        if (count == cap)
+            grow();
+        data()[count++] = e;
+    }
+
+    void emplace_back(const T& e)
+    {
+        push_back(e);
+    }
+
+    iterator erase(iterator it)
+    {
+        if (it + 1 != end())
+            std::copy(it + 1, end(), it);
+        --count;
+        return it;
+    }
 };
 
 // 判断 elem 是否是 ls 中的元素
@@ -92,60 +277,6 @@ bool isLiteral(const std::string& arg)
     return true;
 }
 
-// 求有序容器 A 与 B 的交集
-template<typename T>
-T intersection(const T& A, const T& B)
-{
-    T result;
-    auto A1 = A;
-    auto B1 = B;
-    std::sort(A1.begin(), A1.end());
-    std::sort(B1.begin(), B1.end());
-    std::set_intersection(
-        A1.begin(), A1.end(),
-        B1.begin(), B1.end(),
-        std::back_inserter(result)
-    );
-
-    return result;
-}
-
-// 求有序容器 A 与 B 的并集
-template<typename T>
-T setunion(const T& A, const T& B)
-{
-    T result;
-    auto A1 = A;
-    auto B1 = B;
-    std::sort(A1.begin(), A1.end());
-    std::sort(B1.begin(), B1.end());
-    std::set_union(
-        A1.begin(), A1.end(),
-        B1.begin(), B1.end(),
-        std::back_inserter(result)
-    );
-
-    return result;
-}
-
-// 求有序容器 A 与 B 的差集
-template<typename T>
-T difference(const T& A, const T& B)
-{
-    T result;
-    auto A1 = A;
-    auto B1 = B;
-    std::sort(A1.begin(), A1.end());
-    std::sort(B1.begin(), B1.end());
-    std::set_difference(
-        A1.begin(), A1.end(),
-        B1.begin(), B1.end(),
-        std::back_inserter(result)
-    );
-
-    return result;
-}
-
 // 判断序列 A 是否以序列 B 开头
 template<typename T>
 bool startWith(const T& A, const T& B)
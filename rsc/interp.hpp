@@ -0,0 +1,349 @@
+#ifndef __INTERP_HPP__
+#define __INTERP_HPP__
+
+#include <unordered_map>
+#include "global.hpp"
+
+// 四元式的参考解释器
+// 变量与数组元素均为 64 位整数，算术运算按补码回绕，除数为零时商与余数均为 0；
+// 未赋值的变量与数组元素取由名字、下标与种子散列得到的小整数，同一种子下每次执行的输入相同
+// 标号 L<k> 表示第 k 个基本块；跳转结束当前基本块，否则接着执行下一个基本块，
+// 遇到 HALT 或执行完最后一个基本块时结束
+
+// 初值的取值范围 [0, InterpValueRange)，取得较小以使数组下标相互重叠、条件跳转两个方向都能执行到
+static const int64_t InterpValueRange = 32;
+
+// 一个程序：按块号排列的基本块及各块的出口活跃变量，名字驻留于共用的 SymbolTable
+struct QuadProgram
+{
+    std::vector<std::vector<QuadExp>> blocks;
+    std::vector<std::vector<uint32_t>> outs;
+};
+
+// 动态执行计数
+struct ExecCounts
+{
+    uint64_t blocks = 0;        // 执行的基本块数
+    uint64_t instructions = 0;  // 执行的四元式数
+    uint64_t loads = 0;         // 读数组次数
+    uint64_t stores = 0;        // 写数组次数
+    uint64_t branches = 0;      // 条件跳转次数
+    uint64_t taken = 0;         // 其中发生跳转的次数
+
+    ExecCounts& operator+=(const ExecCounts& other)
+    {
+        blocks += other.blocks;
+        instructions += other.instructions;
+        loads += other.loads;
+        stores += other.stores;
+        branches += other.branches;
+        taken += other.taken;
+        return *this;
+    }
+};
+
+// 基本块的出口
+enum ExitKind : uint8_t
+{
+    EXIT_NEXT,      // 顺序执行下一个基本块
+    EXIT_JUMP,      // 跳转到 target
+    EXIT_HALT,
+    EXIT_FAULT      // 无法执行，原因为 fault，出错的四元式为第 at 条
+};
+
+struct BlockExit
+{
+    uint8_t kind = EXIT_NEXT;
+    int target = -1;
+    size_t at = 0;
+    const char* fault = "";
+
+    bool operator==(const BlockExit& other) const
+    {
+        return kind == other.kind && target == other.target;
+    }
+
+    bool operator!=(const BlockExit& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+// 数组元素：数组名的编号与下标
+struct ArrayCell
+{
+    uint32_t array;
+    int64_t index;
+
+    bool operator==(const ArrayCell& other) const
+    {
+        return array == other.array && index == other.index;
+    }
+};
+
+// splitmix64 的混合函数
+uint64_t interpMix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+struct ArrayCellHash
+{
+    size_t operator()(const ArrayCell& c) const
+    {
+        return size_t(interpMix(uint64_t(c.index) ^ (uint64_t(c.array) << 40)));
+    }
+};
+
+// 按补码回绕计算 v2 op v3
+int64_t interpArith(uint8_t op, int64_t v2, int64_t v3)
+{
+    uint64_t a = uint64_t(v2), b = uint64_t(v3);
+    switch (op)
+    {
+        case OP_ADD:
+            return int64_t(a + b);
+        case OP_SUB:
+            return int64_t(a - b);
+        case OP_MUL:
+            return int64_t(a * b);
+        case OP_DIV:
+            if (v3 == 0)
+                return 0;
+            // INT64_MIN / -1 溢出，按回绕取反
+            return v3 == -1 ? int64_t(0 - a) : v2 / v3;
+        default:
+            return (v3 == 0 || v3 == -1) ? 0 : v2 % v3;
+    }
+}
+
+// 判断条件跳转 op 在 v2, v3 上是否跳转
+bool interpCondition(uint8_t op, int64_t v2, int64_t v3)
+{
+    switch (op)
+    {
+        case OP_JGT:
+            return v2 > v3;
+        case OP_JGE:
+            return v2 >= v3;
+        case OP_JLT:
+            return v2 < v3;
+        case OP_JLE:
+            return v2 <= v3;
+        case OP_JEQ:
+            return v2 == v3;
+        default:
+            return v2 != v3;
+    }
+}
+
+// 执行四元式的机器：保存全部变量与数组，记录每次写入前的旧值，
+// 以便在同一个入口状态上先后执行同一基本块的两个版本
+class QuadMachine
+{
+private:
+    const SymbolTable& syms;
+    size_t blockCount;
+    uint64_t seed = 0;
+
+    std::vector<uint64_t> nameHash;     // 各名字的散列值，用于生成初值
+    std::vector<int> labels;            // 各名字作为标号时对应的块号，-1 表示不是标号，-2 表示尚未解析
+    std::vector<int64_t> vars;
+    std::unordered_map<ArrayCell, int64_t, ArrayCellHash> arrays;
+
+    std::vector<std::pair<uint32_t, int64_t>> varLog;
+    std::vector<std::pair<ArrayCell, int64_t>> cellLog;
+
+    int64_t initial(uint64_t h) const
+    {
+        return int64_t(interpMix(h ^ seed) % uint64_t(InterpValueRange));
+    }
+
+    int64_t value(const Operand& arg) const
+    {
+        switch (arg.kind)
+        {
+            case OPD_NAME:
+                return vars[arg.id];
+            case OPD_IMM:
+                return int64_t(arg.id);
+            case OPD_LIT:
+                return syms.literal(arg.id);
+            default:
+                return 0;
+        }
+    }
+
+    void assign(uint32_t id, int64_t v)
+    {
+        varLog.emplace_back(id, vars[id]);
+        vars[id] = v;
+    }
+
+    void store(const ArrayCell& c, int64_t v)
+    {
+        cellLog.emplace_back(c, load(c));
+        arrays[c] = v;
+    }
+
+    // 标号 L<k> 对应的块号，不是合法的标号时返回 -1
+    int resolve(uint32_t id)
+    {
+        if (labels[id] != -2)
+            return labels[id];
+
+        const std::string& s = syms.name(id);
+        int k = -1;
+        if (s.size() > 1 && s.size() < 11 && s[0] == 'L'
+            && std::all_of(s.begin() + 1, s.end(), [](char c) { return c >= '0' && c <= '9'; }))
+        {
+            long long n = std::stoll(s.substr(1));
+            if (size_t(n) < blockCount)
+                k = int(n);
+        }
+        return labels[id] = k;
+    }
+
+    static BlockExit fault(size_t at, const char* reason)
+    {
+        BlockExit e;
+        e.kind = EXIT_FAULT;
+        e.at = at;
+        e.fault = reason;
+        return e;
+    }
+
+public:
+    // syms 中的名字在机器的生存期内不能再增加
+    QuadMachine(const SymbolTable& syms, size_t blockCount) : syms(syms), blockCount(blockCount)
+    {
+        nameHash.resize(syms.size());
+        for (size_t id = 0; id < syms.size(); ++id)
+        {
+            // FNV-1a
+            uint64_t h = 14695981039346656037ull;
+            for (auto&& c : syms.name(uint32_t(id)))
+            {
+                h ^= (unsigned char)c;
+                h *= 1099511628211ull;
+            }
+            nameHash[id] = h;
+        }
+        labels.assign(syms.size(), -2);
+    }
+
+    // 以种子 s 重新生成全部初值
+    void reset(uint64_t s)
+    {
+        seed = interpMix(s);
+        vars.resize(syms.size());
+        for (size_t id = 0; id < vars.size(); ++id)
+            vars[id] = initial(nameHash[id]);
+        arrays.clear();
+        clearLog();
+    }
+
+    int64_t variable(uint32_t id) const
+    {
+        return vars[id];
+    }
+
+    int64_t load(const ArrayCell& c) const
+    {
+        auto it = arrays.find(c);
+        if (it != arrays.end())
+            return it->second;
+        return initial(nameHash[c.array] ^ interpMix(uint64_t(c.index)));
+    }
+
+    // 自上次 clearLog() 以来的写入及其旧值，按写入顺序排列
+    const std::vector<std::pair<uint32_t, int64_t>>& writtenVars() const
+    {
+        return varLog;
+    }
+
+    const std::vector<std::pair<ArrayCell, int64_t>>& writtenCells() const
+    {
+        return cellLog;
+    }
+
+    void clearLog()
+    {
+        varLog.clear();
+        cellLog.clear();
+    }
+
+    // 撤销自上次 clearLog() 以来的全部写入
+    void rollback()
+    {
+        for (auto&& w : reverse(varLog))
+            vars[w.first] = w.second;
+        for (auto&& w : reverse(cellLog))
+            arrays[w.first] = w.second;
+        clearLog();
+    }
+
+    // 执行一个基本块，动态计数累加到 counts
+    BlockExit run(const std::vector<QuadExp>& code, ExecCounts& counts)
+    {
+        ++counts.blocks;
+        for (size_t k = 0; k < code.size(); ++k)
+        {
+            const QuadExp& e = code[k];
+            ++counts.instructions;
+            switch (e.op)
+            {
+                case OP_SET:
+                    assign(e.a1, value(e.operand(2)));
+                    break;
+                case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+                    assign(e.a1, interpArith(e.op, value(e.operand(2)), value(e.operand(3))));
+                    break;
+                case OP_FAR:
+                    if (e.operand(2).kind != OPD_NAME)
+                        return fault(k, "array is not a name");
+                    ++counts.loads;
+                    assign(e.a1, load(ArrayCell{ e.a2, value(e.operand(3)) }));
+                    break;
+                case OP_TAR:
+                    if (e.operand(1).kind != OPD_NAME)
+                        return fault(k, "array is not a name");
+                    ++counts.stores;
+                    store(ArrayCell{ e.a1, value(e.operand(2)) }, value(e.operand(3)));
+                    break;
+                case OP_HALT:
+                {
+                    BlockExit exit;
+                    exit.kind = EXIT_HALT;
+                    return exit;
+                }
+                case OP_NONE:
+                    return fault(k, "unknown instruction");
+                default:
+                {
+                    // 无条件跳转与条件跳转，目标均为第 1 个操作数
+                    if (e.op != OP_JMP)
+                    {
+                        ++counts.branches;
+                        if (!interpCondition(e.op, value(e.operand(2)), value(e.operand(3))))
+                            break;
+                        ++counts.taken;
+                    }
+                    int target = e.operand(1).kind == OPD_NAME ? resolve(e.a1) : -1;
+                    if (target == -1)
+                        return fault(k, "unresolved label");
+                    BlockExit exit;
+                    exit.kind = EXIT_JUMP;
+                    exit.target = target;
+                    return exit;
+                }
+            }
+        }
+        return BlockExit{};
+    }
+};
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef __PERF_HPP__
+#define __PERF_HPP__
+
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <string>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#define PERF_SUPPORTED 1
+#else
+#define PERF_SUPPORTED 0
+#endif
+
+// 硬件性能计数器（Linux perf_event_open）
+// 所有计数器作为一组只统计当前线程的用户态，一次 read 取得全部计数；
+// 无法打开的计数器（容器、虚拟机或权限不足时常见）单独跳过，报告中记为 null
+
+enum PerfEventKind : uint8_t
+{
+    PEV_CYCLES,
+    PEV_INSTRUCTIONS,
+    PEV_L1D_MISSES,
+    PEV_LLC_MISSES,
+    PEV_BRANCH_MISSES,
+    PEV_COUNT
+};
+
+static const char* const perfEventNames[] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"
+};
+
+class PerfCounters
+{
+private:
+    int fds[PEV_COUNT];
+    int slot[PEV_COUNT];      // 各计数器在组读出结果中的位置，-1 表示不可用
+    int opened = 0;
+    std::string error;
+
+#if PERF_SUPPORTED
+    static int openEvent(PerfEventKind e, int group)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        switch (e)
+        {
+            case PEV_CYCLES:
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case PEV_INSTRUCTIONS:
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case PEV_L1D_MISSES:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+            case PEV_LLC_MISSES:
+                attr.config = PERF_COUNT_HW_CACHE_MISSES;
+                break;
+            default:
+                attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+        }
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.disabled = group == -1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return int(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+    }
+#endif
+
+public:
+    PerfCounters()
+    {
+        for (int k = 0; k < PEV_COUNT; ++k)
+            fds[k] = slot[k] = -1;
+    }
+
+    ~PerfCounters()
+    {
+        close();
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // 为当前线程打开计数器并开始计数，至少一个可用时返回 true
+    bool open()
+    {
+        close();
+        error.clear();
+#if PERF_SUPPORTED
+        int leader = -1;
+        for (int k = 0; k < PEV_COUNT; ++k)
+        {
+            int fd = openEvent(PerfEventKind(k), leader);
+            if (fd == -1)
+            {
+                if (error.empty())
+                    error = std::string(perfEventNames[k]) + ": " + std::strerror(errno);
+                continue;
+            }
+            if (leader == -1)
+                leader = fd;
+            fds[k] = fd;
+            slot[k] = opened++;
+        }
+        if (leader == -1)
+            return false;
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        return true;
+#else
+        error = "perf_event_open is only available on Linux";
+        return false;
+#endif
+    }
+
+    void close()
+    {
+#if PERF_SUPPORTED
+        for (int k = 0; k < PEV_COUNT; ++k)
+            if (fds[k] != -1)
+                ::close(fds[k]);
+#endif
+        for (int k = 0; k < PEV_COUNT; ++k)
+            fds[k] = slot[k] = -1;
+        opened = 0;
+    }
+
+    bool enabled() const
+    {
+        return opened != 0;
+    }
+
+    bool available(int e) const
+    {
+        return slot[e] != -1;
+    }
+
+    // 第一个无法打开的计数器及原因
+    const std::string& lastError() const
+    {
+        return error;
+    }
+
+    // 读出各计数器的当前值，不可用的为 0
+    void read(uint64_t values[PEV_COUNT]) const
+    {
+        for (int k = 0; k < PEV_COUNT; ++k)
+            values[k] = 0;
+#if PERF_SUPPORTED
+        uint64_t buf[1 + PEV_COUNT];
+        int leader = -1;
+        for (int k = 0; k < PEV_COUNT && leader == -1; ++k)
+            leader = fds[k];
+        if (leader == -1 || ::read(leader, buf, sizeof(buf)) < ssize_t(sizeof(uint64_t)))
+            return;
+        for (int k = 0; k < PEV_COUNT; ++k)
+            if (slot[k] != -1 && uint64_t(slot[k]) < buf[0])
+                values[k] = buf[1 + slot[k]];
+#endif
+    }
+};
+
+// 当前线程的计数器，--perf 时打开；分片模式下子进程须重新打开，继承的计数器统计的是父进程
+static PerfCounters perfCounters;
+
+#endif
@@ -0,0 +1,567 @@
+#ifndef __SHARD_HPP__
+#define __SHARD_HPP__
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <map>
+#include "global.hpp"
+#include "json.hpp"
+#include "stats.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#define SHARD_FORK_SUPPORTED 1
+#else
+#define SHARD_FORK_SUPPORTED 0
+#endif
+
+// 多进程分片模式
+// 父进程不解析整个输入，只扫描一遍记下每个基本块的文本在文件中的位置，
+// 按字节数将 blocks 切分为 N 个块号连续的分片，每个分片由一个 fork 出的子进程读入并优化，
+// 子进程把每个基本块预先序列化为 JSON 片段写入临时目录，
+// 父进程按原顺序直接拼接这些片段得到输出，不再重新解析
+
+using json = nlohmann::json;
+
+// 优化第 i 个基本块 blk，并将其 DAG 写入 DAGout
+using BlockOptimizer = std::function<void(json& blk, size_t i, std::ostream& DAGout)>;
+
+// 为 j.dump(4) 的结果整体增加 depth 层缩进，使其可以直接嵌入上层对象
+std::string indentDump(const json& j, size_t depth)
+{
+    std::string text = j.dump(4);
+    std::string pad(4 * depth, ' ');
+    std::string result;
+    result.reserve(text.size() + text.size() / 8);
+
+    for (auto&& c : text)
+    {
+        result.push_back(c);
+        if (c == '\n')
+            result += pad;
+    }
+    return result;
+}
+
+// 一个 JSON 值在输入文件中的字节范围
+struct TextSpan
+{
+    size_t offset = 0, length = 0;
+};
+
+// 输入文件的轮廓：顶层各成员与 blocks 各成员的文本位置，键按 json 对象的顺序排列
+struct InputOutline
+{
+    std::map<std::string, TextSpan> members;
+    std::map<std::string, TextSpan> blocks;
+    bool blocksIsObject = false;
+};
+
+// 逐字节扫描 JSON 文本而不建立 DOM，只记录值的起止位置
+class OutlineScanner
+{
+private:
+    std::streambuf* in;
+    size_t pos = 0;
+
+    int peek()
+    {
+        return in->sgetc();
+    }
+
+    int get()
+    {
+        int c = in->sbumpc();
+        if (c != EOF)
+            ++pos;
+        return c;
+    }
+
+    void skipSpace()
+    {
+        while (peek() == ' ' || peek() == '\t' || peek() == '\n' || peek() == '\r')
+            get();
+    }
+
+    // 读入一个字符串记号（含引号），转义序列交由 json 解码
+    bool readString(std::string& raw)
+    {
+        raw.clear();
+        if (get() != '"')
+            return false;
+        raw.push_back('"');
+        for (int c; (c = get()) != EOF;)
+        {
+            raw.push_back(char(c));
+            if (c == '"')
+                return true;
+            if (c == '\\')
+            {
+                if ((c = get()) == EOF)
+                    return false;
+                raw.push_back(char(c));
+            }
+        }
+        return false;
+    }
+
+    // 跳过一个任意的值
+    bool skipValue()
+    {
+        std::string raw;
+        int c = peek();
+        if (c == '"')
+            return readString(raw);
+        if (c != '{' && c != '[')
+        {
+            // 数、true、false、null
+            size_t start = pos;
+            while ((c = peek()) != EOF && c != ',' && c != '}' && c != ']'
+                && c != ' ' && c != '\t' && c != '\n' && c != '\r')
+                get();
+            return pos > start;
+        }
+
+        size_t depth = 0;
+        do
+        {
+            c = peek();
+            if (c == '"')
+            {
+                if (!readString(raw))
+                    return false;
+                continue;
+            }
+            if (c == EOF)
+                return false;
+            get();
+            if (c == '{' || c == '[')
+                ++depth;
+            else if (c == '}' || c == ']')
+                --depth;
+        } while (depth > 0);
+        return true;
+    }
+
+    // 扫描一个对象，对每个成员调用 member(键)，由 member 读过该成员的值
+    template <typename F>
+    bool scanObject(F&& member)
+    {
+        std::string raw;
+        skipSpace();
+        if (get() != '{')
+            return false;
+        skipSpace();
+        if (peek() == '}')
+        {
+            get();
+            return true;
+        }
+        while (true)
+        {
+            skipSpace();
+            if (!readString(raw))
+                return false;
+            skipSpace();
+            if (get() != ':')
+                return false;
+            skipSpace();
+            if (!member(json::parse(raw).get<std::string>()))
+                return false;
+
+            skipSpace();
+            int c = get();
+            if (c == '}')
+                return true;
+            if (c != ',')
+                return false;
+        }
+    }
+
+    // 跳过一个值并返回其位置
+    bool skipSpan(TextSpan& span)
+    {
+        span.offset = pos;
+        bool ok = skipValue();
+        span.length = pos - span.offset;
+        return ok;
+    }
+
+public:
+    explicit OutlineScanner(std::istream& in) : in(in.rdbuf()) {}
+
+    bool scan(InputOutline& outline)
+    {
+        return scanObject([&](const std::string& key)
+        {
+            TextSpan& span = outline.members[key];
+            if (key != "blocks" || peek() != '{')
+            {
+                if (key == "blocks")
+                    outline.blocksIsObject = false;
+                return skipSpan(span);
+            }
+
+            outline.blocksIsObject = true;
+            outline.blocks.clear();
+            span.offset = pos;
+            bool ok = scanObject([&](const std::string& blkKey)
+            {
+                return skipSpan(outline.blocks[blkKey]);
+            });
+            span.length = pos - span.offset;
+            return ok;
+        });
+    }
+};
+
+// 读出并解析文件中 span 处的值
+bool parseSpan(std::ifstream& in, const TextSpan& span, std::string& buffer, json& value)
+{
+    buffer.resize(span.length);
+    in.clear();
+    in.seekg(span.offset);
+    if (!in.read(&buffer[0], span.length))
+        return false;
+    value = json::parse(buffer, nullptr, false);
+    return !value.is_discarded();
+}
+
+// 分片的临时目录：在输出文件旁以 mkdtemp 创建，同时运行的多个实例互不冲突
+std::string makeShardDir(const std::string& base)
+{
+#if SHARD_FORK_SUPPORTED
+    std::string pattern = base + ".shards.XXXXXX";
+    std::vector<char> path(pattern.begin(), pattern.end());
+    path.push_back('\0');
+    if (mkdtemp(path.data()) == nullptr)
+        return "";
+    return path.data();
+#else
+    return "";
+#endif
+}
+
+// 分片的临时文件名
+std::string shardFileName(const std::string& dir, size_t k, const char* suffix)
+{
+    return dir + "/" + std::to_string(k) + suffix;
+}
+
+// 子进程：读入并优化 [lo, hi) 内的基本块，写出 JSON 片段、片段索引和 DAG 文本
+bool runShard(const std::string& infile, const std::vector<TextSpan>& where, size_t lo, size_t hi, size_t k,
+    const std::string& dir, const BlockOptimizer& optimize)
+{
+    std::ifstream input(infile, std::ios::binary);
+    std::ofstream frag(shardFileName(dir, k, ".frag"), std::ios::binary);
+    std::ofstream index(shardFileName(dir, k, ".idx"));
+    std::ofstream DAGout(shardFileName(dir, k, ".dag"), std::ios::binary);
+
+    runStats.resetForWorker();
+    if (!traceLog.redirect(int(k) + 1, shardFileName(dir, k, ".trace")))
+        return false;
+    if (perfCounters.enabled())
+        perfCounters.open();
+
+    size_t offset = 0;
+    std::string buffer;
+    json blk;
+    for (size_t i = lo; i < hi; ++i)
+    {
+        BlockSpan span(i, hi - i);
+        {
+            PhaseTimer timer(PH_LOAD);
+            if (!parseSpan(input, where[i], buffer, blk))
+                return false;
+        }
+        optimize(blk, i, DAGout);
+
+        runStats.resumeBlock();
+        {
+            PhaseTimer timer(PH_SERIALIZE);
+            std::string text = indentDump(blk, 2);
+            frag << text;
+            index << offset << " " << text.size() << "\n";
+            offset += text.size();
+        }
+        runStats.endBlock();
+    }
+
+    if (traceLog.enabled())
+        traceLog.counter("pending blocks", wallNow(), 0);
+    traceLog.flush();
+
+    frag.flush();
+    index.flush();
+    DAGout.flush();
+    if (!runStats.save(shardFileName(dir, k, ".stats")))
+        return false;
+    return frag.good() && index.good() && DAGout.good();
+}
+
+// 父进程：按原有的键顺序拼接各分片的片段，输出与单进程 j.dump(4) 完全一致的文本
+// top 为除 blocks 以外的顶层成员，blocks 中块号不在 [0, total) 内的成员从输入文件中原样解析输出
+bool mergeShards(const json& top, const InputOutline& outline, std::ifstream& input, size_t total,
+    const std::vector<size_t>& bounds, const std::string& dir, std::ostream& jout)
+{
+    size_t shards = bounds.size() - 1;
+
+    // 第 i 个块所在的分片及其片段在分片文件中的位置
+    std::vector<std::tuple<size_t, size_t, size_t>> where(total);
+    std::vector<std::ifstream> frags;
+
+    for (size_t k = 0; k < shards; ++k)
+    {
+        std::ifstream index(shardFileName(dir, k, ".idx"));
+        for (size_t i = bounds[k]; i < bounds[k + 1]; ++i)
+        {
+            size_t offset = 0, length = 0;
+            if (!(index >> offset >> length))
+                return false;
+            where[i] = std::make_tuple(k, offset, length);
+        }
+        frags.emplace_back(shardFileName(dir, k, ".frag"), std::ios::binary);
+    }
+
+    std::string buffer;
+    auto copyFragment = [&](size_t i) -> bool
+    {
+        auto [k, offset, length] = where[i];
+        buffer.resize(length);
+        frags[k].seekg(offset);
+        return bool(frags[k].read(&buffer[0], length));
+    };
+
+    // 与 json::dump(4) 的格式保持一致
+    jout << "{";
+    bool firstKey = true;
+    for (auto&& [key, value] : top.items())
+    {
+        jout << (firstKey ? "\n    " : ",\n    ") << json(key).dump() << ": ";
+        firstKey = false;
+
+        if (key != "blocks" || !outline.blocksIsObject || outline.blocks.empty())
+        {
+            jout << indentDump(value, 1);
+            continue;
+        }
+
+        jout << "{";
+        bool firstBlock = true;
+        for (auto&& [blkKey, span] : outline.blocks)
+        {
+            jout << (firstBlock ? "\n        " : ",\n        ") << json(blkKey).dump() << ": ";
+            firstBlock = false;
+
+            size_t i = total;
+            if (!blkKey.empty() && isLiteral(blkKey) && std::to_string(std::stoull(blkKey)) == blkKey)
+                i = std::stoull(blkKey);
+
+            if (i < total)
+            {
+                if (!copyFragment(i))
+                    return false;
+                jout << buffer;
+            }
+            else
+            {
+                json blk;
+                if (!parseSpan(input, span, buffer, blk))
+                    return false;
+                jout << indentDump(blk, 2);
+            }
+        }
+        jout << "\n    }";
+    }
+    jout << (firstKey ? "}" : "\n}");
+
+    return bool(jout);
+}
+
+// 将各分片的 DAG 文本按块号顺序拼接
+bool mergeShardDAGs(size_t shards, const std::string& dir, std::ostream& DAGout)
+{
+    for (size_t k = 0; k < shards; ++k)
+    {
+        std::ifstream in(shardFileName(dir, k, ".dag"), std::ios::binary);
+        if (!in)
+            return false;
+        if (in.peek() != std::ifstream::traits_type::eof())
+            DAGout << in.rdbuf();
+    }
+    return bool(DAGout);
+}
+
+// 删除临时目录及其中的文件，子进程失败时也会调用
+void removeShardFiles(size_t shards, const std::string& dir)
+{
+    for (size_t k = 0; k < shards; ++k)
+        for (auto&& suffix : { ".frag", ".idx", ".dag", ".stats", ".trace" })
+            std::remove(shardFileName(dir, k, suffix).c_str());
+#if SHARD_FORK_SUPPORTED
+    rmdir(dir.c_str());
+#endif
+}
+
+// 读入 outline 中除 blocks 以外的顶层成员及 summary.total_blocks，
+// 并求出第 i 个基本块的文本位置；blocks 中缺少某个块时返回 false
+bool loadOutline(std::ifstream& input, const InputOutline& outline, json& top, std::vector<TextSpan>& where)
+{
+    std::string buffer;
+    for (auto&& [key, span] : outline.members)
+    {
+        if (key == "blocks" && outline.blocksIsObject)
+        {
+            top[key] = json::object();
+            continue;
+        }
+        if (!parseSpan(input, span, buffer, top[key]))
+            return false;
+    }
+
+    if (!top.contains("summary") || !top["summary"].contains("total_blocks")
+        || !top["summary"]["total_blocks"].is_number_unsigned())
+        return false;
+    size_t total = top["summary"]["total_blocks"];
+
+    where.assign(total, {});
+    for (size_t i = 0; i < total; ++i)
+    {
+        auto it = outline.blocks.find(std::to_string(i));
+        if (it == outline.blocks.end())
+            return false;
+        where[i] = it->second;
+    }
+    return true;
+}
+
+// 按字节数将 [0, total) 切分为 shards 段块号连续的分片，返回 shards + 1 个分界
+std::vector<size_t> shardBounds(const std::vector<TextSpan>& where, size_t shards)
+{
+    size_t total = where.size(), bytes = 0;
+    for (auto&& w : where)
+        bytes += w.length;
+
+    std::vector<size_t> bounds{ 0 };
+    size_t sum = 0;
+    for (size_t i = 0; i < total && bounds.size() < shards; ++i)
+    {
+        sum += where[i].length;
+        // 累计字节数越过下一个分界时在此处切开
+        while (bounds.size() < shards && sum * shards >= bytes * bounds.size())
+            bounds.emplace_back(i + 1);
+    }
+    while (bounds.size() <= shards)
+        bounds.emplace_back(total);
+    return bounds;
+}
+
+// 以 shards 个子进程优化 infile 中的基本块，并将结果写入 jout 与 DAGout；base 为输出文件名，临时目录建在其旁
+// 所有基本块处理完、写出结果之前调用 finish(j)，用于填写汇总信息
+// 成功时返回 true；不支持 fork 的平台上退化为单进程顺序处理
+bool runSharded(const std::string& infile, size_t shards, const std::string& base,
+    std::ostream& jout, std::ostream& DAGout, const BlockOptimizer& optimize,
+    const std::function<void(json&)>& finish = nullptr)
+{
+#if SHARD_FORK_SUPPORTED
+    std::ifstream input(infile, std::ios::binary);
+    InputOutline outline;
+    json top;
+    std::vector<TextSpan> where;
+    {
+        PhaseTimer timer(PH_LOAD);
+        if (!input || !OutlineScanner(input).scan(outline) || !loadOutline(input, outline, top, where))
+        {
+            std::cerr << "DAGOpt: cannot read the blocks of " << infile << std::endl;
+            return false;
+        }
+    }
+    size_t total = where.size();
+    shards = std::max<size_t>(1, std::min(shards, total));
+    std::vector<size_t> bounds = shardBounds(where, shards);
+
+    std::string dir = makeShardDir(base);
+    if (dir.empty())
+    {
+        std::perror("mkdtemp");
+        return false;
+    }
+
+    std::vector<pid_t> workers;
+    bool ok = true;
+
+    // 子进程继承时间线的缓冲区，fork 前先写出
+    traceLog.flush();
+
+    for (size_t k = 0; k < shards; ++k)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            bool done = false;
+            try
+            {
+                done = runShard(infile, where, bounds[k], bounds[k + 1], k, dir, optimize);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "DAGOpt: shard " << k << ": " << e.what() << std::endl;
+            }
+            _exit(done ? 0 : 1);
+        }
+        if (pid < 0)
+        {
+            std::perror("fork");
+            ok = false;
+            break;
+        }
+        workers.emplace_back(pid);
+    }
+
+    for (auto&& pid : workers)
+    {
+        int status = 0;
+        if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            ok = false;
+    }
+
+    // 各分片的计数与计时按块号顺序读回
+    for (size_t k = 0; ok && k < shards; ++k)
+    {
+        ok = runStats.load(shardFileName(dir, k, ".stats"));
+        if (ok && traceLog.enabled())
+            ok = traceLog.append(shardFileName(dir, k, ".trace"));
+    }
+
+    if (ok)
+    {
+        if (finish)
+            finish(top);
+        PhaseTimer timer(PH_DUMP);
+        ok = mergeShards(top, outline, input, total, bounds, dir, jout) && mergeShardDAGs(shards, dir, DAGout);
+    }
+
+    removeShardFiles(shards, dir);
+    return ok;
+#else
+    std::ifstream input(infile);
+    json j;
+    {
+        PhaseTimer timer(PH_LOAD);
+        input >> j;
+    }
+    size_t total = j["summary"]["total_blocks"];
+    for (size_t i = 0; i < total; ++i)
+        optimize(j["blocks"][std::to_string(i)], i, DAGout);
+    if (finish)
+        finish(j);
+    PhaseTimer timer(PH_DUMP);
+    jout << j.dump(4);
+    return bool(jout);
+#endif
+}
+
+#endif
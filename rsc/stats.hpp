@@ -0,0 +1,467 @@
+#ifndef __STATS_HPP__
+#define __STATS_HPP__
+
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include "global.hpp"
+#include "DAG.hpp"
+#include "trace.hpp"
+#include "perf.hpp"
+#include "alloc.hpp"
+#include "json.hpp"
+
+// 分阶段计时
+// 按阶段与基本块统计墙钟时间（steady_clock）与 CPU 时间，结束时输出 JSON 报告；
+// 未启用时每个计时点只有一次判断
+
+// 计时的阶段：load 与 dump 以整次运行计，其余以基本块计
+enum StatPhase : uint8_t
+{
+    PH_LOAD,        // 读入并解析输入 json
+    PH_CONVERT,     // 将三地址代码解析为四元式
+    PH_BUILD,       // 构造 DAG
+    PH_EMIT,        // 生成优化后的四元式
+    PH_PRINT,       // 输出三地址代码与 DAG 文本
+    PH_SERIALIZE,   // 序列化基本块（分片模式）
+    PH_DUMP,        // 写出结果 json
+    PH_COUNT
+};
+
+static const char* const phaseNames[] = {
+    "load", "convert", "build", "emit", "print", "serialize", "dump"
+};
+
+// 当前线程已使用的 CPU 时间（纳秒）
+uint64_t cpuNow()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+#else
+    return uint64_t(double(std::clock()) * 1e9 / CLOCKS_PER_SEC);
+#endif
+}
+
+// 单调的墙钟时间（纳秒）
+uint64_t wallNow()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// 优化效果计数的 JSON 形式
+nlohmann::json countersJson(const OptCounters& c)
+{
+    return {
+        {"quads_in", c.quadsIn}, {"quads_out", c.quadsOut},
+        {"nodes_created", c.nodesCreated}, {"cse_hits", c.cseHits},
+        {"constant_folds", c.folds}, {"dead_roots", c.deadRoots},
+        {"futile_sets", c.futileSets}, {"tar_kills", c.tarKills},
+        {"quad_ratio", c.quadsIn == 0 ? 1.0 : double(c.quadsOut) / c.quadsIn}
+    };
+}
+
+// 一个基本块各阶段的耗时（纳秒）
+struct BlockStats
+{
+    size_t block = 0;
+    size_t quads = 0;
+    uint64_t wall[PH_COUNT]{};
+    uint64_t cpu[PH_COUNT]{};
+    uint64_t allocs = 0;        // 以下三项仅在统计堆分配时有效
+    uint64_t allocBytes = 0;
+    uint64_t peakBytes = 0;     // 处理期间堆占用超出开始时的峰值
+};
+
+class RunStats
+{
+private:
+    bool on = false;
+    bool inBlock = false;
+    size_t top = 10;
+    uint64_t startWall = 0;
+    uint64_t wall[PH_COUNT]{};
+    uint64_t cpu[PH_COUNT]{};
+    uint64_t perf[PH_COUNT][PEV_COUNT]{};   // 各阶段的硬件计数，不分基本块
+    uint64_t allocs[PH_COUNT]{};            // 各阶段的堆分配次数与字节数
+    uint64_t allocBytes[PH_COUNT]{};
+    uint64_t peakBytes = 0;                 // 整次运行的堆占用峰值（分片模式下取各子进程的最大值）
+    uint64_t blockAllocs0 = 0, blockBytes0 = 0, blockLive0 = 0;
+    std::vector<BlockStats> blocks;
+    OptCounters totals;
+
+    // 堆占用峰值最大的 top 个块
+    nlohmann::json largestPeaks() const
+    {
+        std::vector<size_t> order(blocks.size());
+        for (size_t k = 0; k < order.size(); ++k)
+            order[k] = k;
+        size_t n = std::min(top, order.size());
+        std::partial_sort(order.begin(), order.begin() + n, order.end(), [&](size_t a, size_t b)
+        {
+            const BlockStats& x = blocks[a];
+            const BlockStats& y = blocks[b];
+            return x.peakBytes != y.peakBytes ? x.peakBytes > y.peakBytes : x.block < y.block;
+        });
+
+        nlohmann::json result = nlohmann::json::array();
+        for (size_t k = 0; k < n; ++k)
+        {
+            const BlockStats& b = blocks[order[k]];
+            result.push_back({ {"block", b.block}, {"quads", b.quads}, {"peak_bytes", b.peakBytes},
+                {"allocs", b.allocs}, {"bytes", b.allocBytes} });
+        }
+        return result;
+    }
+
+    // 按阶段 ph 的墙钟时间选出最慢的 top 个块，ph 为 PH_COUNT 时按各阶段之和
+    nlohmann::json slowest(int ph) const
+    {
+        auto cost = [&](const BlockStats& b)
+        {
+            uint64_t t = 0;
+            for (int k = 0; k < PH_COUNT; ++k)
+                if (ph == PH_COUNT || ph == k)
+                    t += b.wall[k];
+            return t;
+        };
+
+        std::vector<size_t> order(blocks.size());
+        for (size_t k = 0; k < order.size(); ++k)
+            order[k] = k;
+        size_t n = std::min(top, order.size());
+        std::partial_sort(order.begin(), order.begin() + n, order.end(), [&](size_t a, size_t b)
+        {
+            uint64_t ca = cost(blocks[a]), cb = cost(blocks[b]);
+            return ca != cb ? ca > cb : blocks[a].block < blocks[b].block;
+        });
+
+        nlohmann::json result = nlohmann::json::array();
+        for (size_t k = 0; k < n; ++k)
+        {
+            const BlockStats& b = blocks[order[k]];
+            uint64_t c = 0;
+            for (int p = 0; p < PH_COUNT; ++p)
+                if (ph == PH_COUNT || ph == p)
+                    c += b.cpu[p];
+            result.push_back({ {"block", b.block}, {"quads", b.quads},
+                {"wall_us", cost(b) / 1e3}, {"cpu_us", c / 1e3} });
+        }
+        return result;
+    }
+
+public:
+    // 启用计时，报告中列出每个阶段最慢的 slowestN 个块
+    void enable(size_t slowestN)
+    {
+        on = true;
+        top = slowestN;
+        startWall = wallNow();
+    }
+
+    bool enabled() const
+    {
+        return on;
+    }
+
+    // 此后的计时记入第 i 个基本块，直到 endBlock()
+    void beginBlock(size_t i, size_t quads)
+    {
+        if (!on)
+            return;
+        blocks.emplace_back();
+        blocks.back().block = i;
+        blocks.back().quads = quads;
+        inBlock = true;
+
+        if (allocTracker.on)
+        {
+            blockAllocs0 = allocTracker.count;
+            blockBytes0 = allocTracker.bytes;
+            blockLive0 = allocTracker.live;
+            peakBytes = std::max(peakBytes, allocTracker.peak);
+            allocTracker.peak = allocTracker.live;
+        }
+    }
+
+    // 继续记入最近的基本块，用于在优化之后的处理
+    void resumeBlock()
+    {
+        inBlock = on && !blocks.empty();
+    }
+
+    void endBlock()
+    {
+        if (inBlock && allocTracker.on)
+        {
+            BlockStats& b = blocks.back();
+            b.allocs = allocTracker.count - blockAllocs0;
+            b.allocBytes = allocTracker.bytes - blockBytes0;
+            b.peakBytes = std::max(b.peakBytes, allocTracker.peak - blockLive0);
+            peakBytes = std::max(peakBytes, allocTracker.peak);
+        }
+        inBlock = false;
+    }
+
+    void addAllocs(StatPhase ph, uint64_t count, uint64_t bytes)
+    {
+        allocs[ph] += count;
+        allocBytes[ph] += bytes;
+    }
+
+    // 累计一个基本块的优化效果计数，不论是否启用计时
+    void addCounters(const OptCounters& c)
+    {
+        totals += c;
+    }
+
+    const OptCounters& counters() const
+    {
+        return totals;
+    }
+
+    void addPerf(StatPhase ph, const uint64_t delta[PEV_COUNT])
+    {
+        for (int e = 0; e < PEV_COUNT; ++e)
+            perf[ph][e] += delta[e];
+    }
+
+    void add(StatPhase ph, uint64_t wallNs, uint64_t cpuNs)
+    {
+        if (inBlock)
+        {
+            blocks.back().wall[ph] += wallNs;
+            blocks.back().cpu[ph] += cpuNs;
+        }
+        else
+        {
+            wall[ph] += wallNs;
+            cpu[ph] += cpuNs;
+        }
+    }
+
+    // 分片模式的子进程开始时清空从父进程继承的累计值，只保存自己的部分
+    void resetForWorker()
+    {
+        totals = OptCounters{};
+        blocks.clear();
+        inBlock = false;
+        for (int k = 0; k < PH_COUNT; ++k)
+        {
+            wall[k] = cpu[k] = allocs[k] = allocBytes[k] = 0;
+            for (int e = 0; e < PEV_COUNT; ++e)
+                perf[k][e] = 0;
+        }
+        peakBytes = 0;
+        allocTracker.peak = allocTracker.live;
+    }
+
+    // 分片模式下子进程将优化效果计数与计时写入文件，由父进程读回并累加
+    bool save(const std::string& path) const
+    {
+        std::ofstream os(path);
+        os << totals.quadsIn << ' ' << totals.quadsOut << ' ' << totals.nodesCreated << ' '
+            << totals.cseHits << ' ' << totals.folds << ' ' << totals.deadRoots << ' '
+            << totals.futileSets << ' ' << totals.tarKills << '\n';
+        // 不属于任何基本块的计时，如子进程读入并解析各块
+        for (int k = 0; k < PH_COUNT; ++k)
+            os << wall[k] << ' ' << cpu[k] << ' ';
+        os << '\n';
+        for (int k = 0; k < PH_COUNT; ++k)
+            for (int e = 0; e < PEV_COUNT; ++e)
+                os << perf[k][e] << ' ';
+        for (int k = 0; k < PH_COUNT; ++k)
+            os << allocs[k] << ' ' << allocBytes[k] << ' ';
+        os << std::max(peakBytes, allocTracker.peak) << '\n';
+        for (auto&& b : blocks)
+        {
+            os << b.block << ' ' << b.quads;
+            for (int k = 0; k < PH_COUNT; ++k)
+                os << ' ' << b.wall[k] << ' ' << b.cpu[k];
+            os << ' ' << b.allocs << ' ' << b.allocBytes << ' ' << b.peakBytes << '\n';
+        }
+        return bool(os);
+    }
+
+    bool load(const std::string& path)
+    {
+        std::ifstream in(path);
+        OptCounters c;
+        if (!(in >> c.quadsIn >> c.quadsOut >> c.nodesCreated >> c.cseHits
+            >> c.folds >> c.deadRoots >> c.futileSets >> c.tarKills))
+            return false;
+        totals += c;
+        for (int k = 0; k < PH_COUNT; ++k)
+        {
+            uint64_t w = 0, t = 0;
+            if (!(in >> w >> t))
+                return false;
+            add(StatPhase(k), w, t);
+        }
+        for (int k = 0; k < PH_COUNT; ++k)
+            for (int e = 0; e < PEV_COUNT; ++e)
+            {
+                uint64_t v = 0;
+                if (!(in >> v))
+                    return false;
+                perf[k][e] += v;
+            }
+        for (int k = 0; k < PH_COUNT; ++k)
+        {
+            uint64_t n = 0, bytes = 0;
+            if (!(in >> n >> bytes))
+                return false;
+            addAllocs(StatPhase(k), n, bytes);
+        }
+        uint64_t peak = 0;
+        if (!(in >> peak))
+            return false;
+        peakBytes = std::max(peakBytes, peak);
+
+        BlockStats b;
+        while (in >> b.block >> b.quads)
+        {
+            for (int k = 0; k < PH_COUNT; ++k)
+                in >> b.wall[k] >> b.cpu[k];
+            in >> b.allocs >> b.allocBytes >> b.peakBytes;
+            blocks.emplace_back(b);
+        }
+        return in.eof();
+    }
+
+    nlohmann::json report() const
+    {
+        uint64_t totalWall[PH_COUNT], totalCpu[PH_COUNT];
+        size_t quads = 0;
+        for (int k = 0; k < PH_COUNT; ++k)
+        {
+            totalWall[k] = wall[k];
+            totalCpu[k] = cpu[k];
+        }
+        for (auto&& b : blocks)
+        {
+            quads += b.quads;
+            for (int k = 0; k < PH_COUNT; ++k)
+            {
+                totalWall[k] += b.wall[k];
+                totalCpu[k] += b.cpu[k];
+            }
+        }
+
+        double elapsed = (wallNow() - startWall) / 1e9;
+        nlohmann::json r;
+        r["blocks"] = blocks.size();
+        r["quads"] = quads;
+        r["wall_seconds"] = elapsed;
+        r["quads_per_sec"] = elapsed > 0 ? quads / elapsed : 0.0;
+
+        nlohmann::json phases = nlohmann::json::object(), slow = nlohmann::json::object();
+        for (int k = 0; k < PH_COUNT; ++k)
+        {
+            phases[phaseNames[k]] = { {"wall_ms", totalWall[k] / 1e6}, {"cpu_ms", totalCpu[k] / 1e6} };
+            if (perfCounters.enabled())
+                for (int e = 0; e < PEV_COUNT; ++e)
+                    phases[phaseNames[k]][perfEventNames[e]] =
+                        perfCounters.available(e) ? nlohmann::json(perf[k][e]) : nlohmann::json(nullptr);
+            if (allocTracker.on)
+            {
+                phases[phaseNames[k]]["allocs"] = allocs[k];
+                phases[phaseNames[k]]["alloc_bytes"] = allocBytes[k];
+            }
+            if (k != PH_LOAD && k != PH_DUMP)
+                slow[phaseNames[k]] = slowest(k);
+        }
+        slow["total"] = slowest(PH_COUNT);
+        if (allocTracker.on)
+        {
+            uint64_t n = 0;
+            for (int k = 0; k < PH_COUNT; ++k)
+                n += allocs[k];
+            r["allocations"] = { {"allocs", n}, {"allocs_per_quad", quads == 0 ? 0.0 : double(n) / quads},
+                {"peak_bytes", std::max(peakBytes, allocTracker.peak)} };
+            slow["peak_bytes"] = largestPeaks();
+        }
+        r["phases"] = phases;
+        if (perfCounters.enabled() || !perfCounters.lastError().empty())
+            r["perf"] = { {"available", perfCounters.enabled()}, {"error", perfCounters.lastError()} };
+        r["slowest"] = slow;
+        return r;
+    }
+};
+
+// 本次运行的计时
+static RunStats runStats;
+
+// 作用域计时：构造时开始，析构时将耗时记入 runStats，并在时间线上记录一个区间
+class PhaseTimer
+{
+private:
+    StatPhase ph;
+    uint64_t wall0 = 0, cpu0 = 0;
+    uint64_t perf0[PEV_COUNT];
+    uint64_t allocs0 = 0, bytes0 = 0;
+
+public:
+    explicit PhaseTimer(StatPhase ph) : ph(ph)
+    {
+        if (runStats.enabled() || traceLog.enabled())
+        {
+            if (perfCounters.enabled())
+                perfCounters.read(perf0);
+            allocs0 = allocTracker.count;
+            bytes0 = allocTracker.bytes;
+            wall0 = wallNow();
+            cpu0 = cpuNow();
+        }
+    }
+
+    ~PhaseTimer()
+    {
+        if (!runStats.enabled() && !traceLog.enabled())
+            return;
+        uint64_t wall1 = wallNow();
+        if (runStats.enabled())
+            runStats.add(ph, wall1 - wall0, cpuNow() - cpu0);
+        if (runStats.enabled() && allocTracker.on)
+            runStats.addAllocs(ph, allocTracker.count - allocs0, allocTracker.bytes - bytes0);
+        if (runStats.enabled() && perfCounters.enabled())
+        {
+            uint64_t perf1[PEV_COUNT];
+            perfCounters.read(perf1);
+            for (int e = 0; e < PEV_COUNT; ++e)
+                perf1[e] -= perf0[e];
+            runStats.addPerf(ph, perf1);
+        }
+        if (traceLog.enabled())
+            traceLog.span(phaseNames[ph], wall0, wall1);
+    }
+};
+
+// 作用域内为基本块 block 在时间线上的区间，各阶段的区间嵌套其中；
+// 开始时记录当前线程连同该块在内尚未处理的块数
+class BlockSpan
+{
+private:
+    size_t block;
+    uint64_t start = 0;
+
+public:
+    BlockSpan(size_t block, size_t pending) : block(block)
+    {
+        if (traceLog.enabled())
+        {
+            start = wallNow();
+            traceLog.counter("pending blocks", start, pending);
+        }
+    }
+
+    ~BlockSpan()
+    {
+        if (traceLog.enabled())
+            traceLog.span("block", start, wallNow(), (long long)block);
+    }
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef __SYMSET_HPP__
+#define __SYMSET_HPP__
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// 标识符编号集合
+// 集合运算只做判断，不复制、不排序、不分配，找到第一个公共元素即返回
+
+// 判断序列 ids 中是否有元素属于集合 set
+template<typename T, typename Set>
+bool anyIn(const T& ids, const Set& set)
+{
+    for (auto&& id : ids)
+    {
+        if (set.test(id))
+            return true;
+    }
+    return false;
+}
+
+// 以名字表编号为下标的稠密位集
+class SymbolBitset
+{
+private:
+    std::vector<uint64_t> words;
+
+public:
+    // 清空并使其能容纳编号 0 ~ n-1，保留已分配的存储
+    void reset(size_t n)
+    {
+        words.assign((n + 63) / 64, 0);
+    }
+
+    void set(uint32_t id)
+    {
+        if (id / 64 >= words.size())
+            words.resize(id / 64 + 1, 0);
+        words[id / 64] |= uint64_t(1) << (id % 64);
+    }
+
+    bool test(uint32_t id) const
+    {
+        return id / 64 < words.size() && (words[id / 64] >> (id % 64) & 1);
+    }
+
+    bool empty() const
+    {
+        for (auto&& w : words)
+            if (w != 0)
+                return false;
+        return true;
+    }
+};
+
+#endif
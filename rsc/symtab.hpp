@@ -0,0 +1,215 @@
+#ifndef __SYMTAB_HPP__
+#define __SYMTAB_HPP__
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+// 以 64 位整数为键、非负整数为值的开放寻址哈希表
+// 不支持删除；reset() 清空内容但保留已分配的存储
+class FlatMap
+{
+private:
+    struct Slot
+    {
+        uint64_t key;
+        int value;      // -1 表示空槽
+    };
+
+    std::vector<Slot> slots;
+    size_t count{};
+
+    static size_t mix(uint64_t k)
+    {
+        // splitmix64 的终结步骤
+        k ^= k >> 30;
+        k *= 0xbf58476d1ce4e5b9ull;
+        k ^= k >> 27;
+        k *= 0x94d049bb133111ebull;
+        k ^= k >> 31;
+        return size_t(k);
+    }
+
+    void rehash(size_t capacity)
+    {
+        std::vector<Slot> old;
+        old.swap(slots);
+        slots.assign(capacity, Slot{ 0, -1 });
+        count = 0;
+        for (auto&& slot : old)
+            if (slot.value != -1)
+                insert(slot.key, slot.value);
+    }
+
+public:
+    // 返回键 key 对应的值，不存在时返回 -1
+    int find(uint64_t key) const
+    {
+        if (slots.empty())
+            return -1;
+
+        size_t mask = slots.size() - 1;
+        for (size_t i = mix(key) & mask; slots[i].value != -1; i = (i + 1) & mask)
+        {
+            if (slots[i].key == key)
+                return slots[i].value;
+        }
+        return -1;
+    }
+
+    // 插入或覆盖键 key 对应的值，value 必须非负
+    void insert(uint64_t key, int value)
+    {
+        if ((count + 1) * 2 > slots.size())
+            rehash(slots.empty() ? 64 : slots.size() * 2);
+
+        size_t mask = slots.size() - 1;
+        size_t i = mix(key) & mask;
+        while (slots[i].value != -1 && slots[i].key != key)
+            i = (i + 1) & mask;
+
+        if (slots[i].value == -1)
+            ++count;
+        slots[i] = Slot{ key, value };
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    void reset()
+    {
+        if (count == 0)
+            return;
+        std::fill(slots.begin(), slots.end(), Slot{ 0, -1 });
+        count = 0;
+    }
+};
+
+// 标识符驻留表
+// 将一个基本块中出现的名字映射为从 0 开始的稠密 32 位编号，
+// DAG 与四元式内部只保存编号，仅在解析和输出时才与文本相互转换。
+// 无法内联进操作数的 64 位常数同样按值驻留于常数池中。
+// reset() 清空内容但保留已分配的存储，供后续基本块复用
+class SymbolTable
+{
+private:
+    std::vector<std::string> names;
+    size_t count{};
+
+    // 常数池及其按值索引
+    std::vector<int64_t> literals;
+    FlatMap literalIndex;
+
+    // 开放寻址哈希表，保存 编号 + 1，0 表示空槽
+    std::vector<uint32_t> slots;
+
+    static size_t hash(std::string_view s)
+    {
+        // FNV-1a
+        size_t h = 14695981039346656037ull;
+        for (auto&& c : s)
+        {
+            h ^= (unsigned char)c;
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    void rehash(size_t capacity)
+    {
+        slots.assign(capacity, 0);
+        for (size_t id = 0; id < count; ++id)
+        {
+            size_t mask = slots.size() - 1;
+            size_t i = hash(names[id]) & mask;
+            while (slots[i] != 0)
+                i = (i + 1) & mask;
+            slots[i] = uint32_t(id + 1);
+        }
+    }
+
+public:
+    static constexpr uint32_t npos = 0xffffffff;
+
+    // 返回名字 name 的编号，不存在时新建
+    uint32_t intern(std::string_view name)
+    {
+        if ((count + 1) * 2 > slots.size())
+            rehash(slots.empty() ? 64 : slots.size() * 2);
+
+        size_t mask = slots.size() - 1;
+        size_t i = hash(name) & mask;
+        while (slots[i] != 0)
+        {
+            if (names[slots[i] - 1] == name)
+                return slots[i] - 1;
+            i = (i + 1) & mask;
+        }
+
+        if (count < names.size())
+            names[count].assign(name.data(), name.size());
+        else
+            names.emplace_back(name);
+
+        slots[i] = uint32_t(++count);
+        return uint32_t(count - 1);
+    }
+
+    // 返回名字 name 的编号，不存在时返回 npos
+    uint32_t find(std::string_view name) const
+    {
+        if (slots.empty())
+            return npos;
+
+        size_t mask = slots.size() - 1;
+        size_t i = hash(name) & mask;
+        while (slots[i] != 0)
+        {
+            if (names[slots[i] - 1] == name)
+                return slots[i] - 1;
+            i = (i + 1) & mask;
+        }
+        return npos;
+    }
+
+    const std::string& name(uint32_t id) const
+    {
+        return names[id];
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    // 返回常数 value 在常数池中的编号，不存在时新建
+    uint32_t internLiteral(int64_t value)
+    {
+        int id = literalIndex.find(uint64_t(value));
+        if (id != -1)
+            return uint32_t(id);
+
+        literals.emplace_back(value);
+        literalIndex.insert(uint64_t(value), int(literals.size() - 1));
+        return uint32_t(literals.size() - 1);
+    }
+
+    int64_t literal(uint32_t id) const
+    {
+        return literals[id];
+    }
+
+    void reset()
+    {
+        count = 0;
+        std::fill(slots.begin(), slots.end(), 0);
+        literals.clear();
+        literalIndex.reset();
+    }
+};
+
+#endif
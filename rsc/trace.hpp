@@ -0,0 +1,114 @@
+#ifndef __TRACE_HPP__
+#define __TRACE_HPP__
+
+#include <fstream>
+#include <iomanip>
+#include <cstdint>
+#include <string>
+
+// Chrome trace-event 格式的时间线，可直接载入 chrome://tracing 或 Perfetto
+// 主进程为线程 0，分片模式下第 k 个子进程为线程 k + 1；
+// 事件边产生边写出，子进程写入各自的文件，结束时由主进程按顺序追加
+
+class TraceLog
+{
+private:
+    bool on = false;
+    int tid = 0;
+    uint64_t origin = 0;
+    std::ofstream os;
+
+    // 纳秒时间戳转为相对起点的微秒
+    double micros(uint64_t ns) const
+    {
+        return (ns - origin) / 1e3;
+    }
+
+    void threadName(const std::string& name)
+    {
+        os << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+            << ",\"args\":{\"name\":\"" << name << "\"}}";
+    }
+
+public:
+    // 开始记录到 path，start 为时间线的起点（纳秒）
+    bool enable(const std::string& path, uint64_t start)
+    {
+        os.open(path, std::ios::binary);
+        if (!os)
+            return false;
+        os << std::fixed << std::setprecision(3);
+        on = true;
+        origin = start;
+        os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+            << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"DAGOpt\"}}";
+        threadName("main");
+        return true;
+    }
+
+    bool enabled() const
+    {
+        return on;
+    }
+
+    // 子进程改为以线程 worker 写入 path，调用前主进程须已 flush()
+    bool redirect(int worker, const std::string& path)
+    {
+        if (!on)
+            return true;
+        os.close();
+        os.open(path, std::ios::binary);
+        tid = worker;
+        threadName("worker " + std::to_string(worker - 1));
+        return bool(os);
+    }
+
+    void flush()
+    {
+        if (on)
+            os.flush();
+    }
+
+    // 区间事件；block 为所属基本块，-1 表示不属于某个基本块
+    void span(const char* name, uint64_t start, uint64_t end, long long block = -1)
+    {
+        os << ",\n{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+            << ",\"ts\":" << micros(start) << ",\"dur\":" << (end - start) / 1e3;
+        if (block >= 0)
+            os << ",\"args\":{\"block\":" << block << "}";
+        os << "}";
+    }
+
+    // 计数器事件，每个线程一条曲线
+    void counter(const char* name, uint64_t at, size_t value)
+    {
+        os << ",\n{\"name\":\"" << name << " (thread " << tid << ")\",\"ph\":\"C\",\"pid\":1,\"ts\":"
+            << micros(at) << ",\"args\":{\"value\":" << value << "}}";
+    }
+
+    // 追加子进程写出的事件
+    bool append(const std::string& path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+        if (in.peek() != std::ifstream::traits_type::eof())
+            os << in.rdbuf();
+        return bool(os);
+    }
+
+    bool close()
+    {
+        if (!on)
+            return true;
+        os << "\n]}\n";
+        os.close();
+        on = false;
+        return !os.fail();
+    }
+};
+
+// 本次运行的时间线
+static TraceLog traceLog;
+
+#endif
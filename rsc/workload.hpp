@@ -0,0 +1,221 @@
+#ifndef __WORKLOAD_HPP__
+#define __WORKLOAD_HPP__
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+#include <cmath>
+
+// 合成基本块负载
+// 生成的三地址代码均可被 convert() 解析，输出格式与 DAGOpt 的输入文件相同：
+// { "blocks": { "0": { "code": [...], "out": [...] }, ... }, "summary": { "total_blocks": N } }
+
+
+// 合成的基本块：三地址代码及出口活跃变量
+struct SyntheticBlock
+{
+    std::vector<std::string> code;
+    std::vector<std::string> out;
+};
+
+// 负载参数
+struct WorkloadSpec
+{
+    uint64_t seed = 1;
+
+    // 每块四元式数在 [minSize, maxSize] 中选取；logSize 为 true 时按对数均匀分布，小块多、大块少
+    size_t minSize = 4;
+    size_t maxSize = 32;
+    bool logSize = false;
+
+    size_t vars = 8;            // 每块可用的变量 v0 ~ v(vars-1)
+    double redundancy = 0.2;    // 重复之前某个表达式的比例
+    double constants = 0.3;     // 操作数为常数的比例
+    size_t arrays = 2;          // 数组 A0 ~ A(arrays-1)
+    double arrayOps = 0.2;      // 数组操作的比例
+    double stores = 0.4;        // 数组操作中写数组的比例
+    double jumps = 0.3;         // 以条件跳转结尾的块的比例，其余块以强制跳转结尾
+    size_t liveOut = 4;         // 出口活跃变量数的上限
+};
+
+// 可复现的伪随机数发生器（splitmix64），不依赖标准库分布的实现
+class WorkloadRandom
+{
+private:
+    uint64_t state;
+
+public:
+    explicit WorkloadRandom(uint64_t seed) : state(seed) {}
+
+    uint64_t next()
+    {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    // 返回 [0, n) 中的整数
+    size_t below(size_t n)
+    {
+        return n == 0 ? 0 : size_t(next() % n);
+    }
+
+    // 以概率 p 返回 true
+    bool chance(double p)
+    {
+        return double(next() >> 11) * (1.0 / 9007199254740992.0) < p;
+    }
+};
+
+// 按参数逐块生成基本块，同一参数与种子总是生成相同的序列
+class WorkloadGenerator
+{
+private:
+    WorkloadSpec spec;
+    WorkloadRandom rnd;
+
+    struct Expr
+    {
+        std::string a, op, b;
+    };
+
+    size_t blockSize()
+    {
+        if (spec.maxSize <= spec.minSize)
+            return spec.minSize;
+        if (!spec.logSize)
+            return spec.minSize + rnd.below(spec.maxSize - spec.minSize + 1);
+
+        double lo = std::log(double(spec.minSize)), hi = std::log(double(spec.maxSize) + 1);
+        double x = lo + (hi - lo) * (double(rnd.next() >> 11) * (1.0 / 9007199254740992.0));
+        size_t size = size_t(std::exp(x));
+        return size < spec.minSize ? spec.minSize : size > spec.maxSize ? spec.maxSize : size;
+    }
+
+public:
+    explicit WorkloadGenerator(const WorkloadSpec& spec) : spec(spec), rnd(spec.seed) {}
+
+    SyntheticBlock next()
+    {
+        static const char* const ops[] = { "+", "-", "*", "/", "%" };
+        static const char* const rops[] = { ">", ">=", "<", "<=", "==", "!=" };
+
+        SyntheticBlock blk;
+        size_t size = blockSize();
+        size_t vars = spec.vars == 0 ? 1 : spec.vars;
+        size_t temps = 0;
+        std::vector<Expr> history;
+
+        auto variable = [&]() -> std::string
+        {
+            if (temps != 0 && rnd.chance(0.5))
+                return "t" + std::to_string(rnd.below(temps));
+            return "v" + std::to_string(rnd.below(vars));
+        };
+        auto operand = [&]() -> std::string
+        {
+            if (rnd.chance(spec.constants))
+                return std::to_string(rnd.below(100));
+            return variable();
+        };
+        auto dest = [&]() -> std::string
+        {
+            if (rnd.chance(0.5))
+                return "t" + std::to_string(temps++);
+            return "v" + std::to_string(rnd.below(vars));
+        };
+
+        for (size_t k = 0; k < size; ++k)
+        {
+            if (spec.arrays != 0 && rnd.chance(spec.arrayOps))
+            {
+                std::string arr = "A" + std::to_string(rnd.below(spec.arrays));
+                std::string index = operand();
+                if (rnd.chance(spec.stores))
+                    blk.code.emplace_back(arr + " [ " + index + " ] = " + operand());
+                else
+                    blk.code.emplace_back(dest() + " = " + arr + " [ " + index + " ]");
+            }
+            else if (!history.empty() && rnd.chance(spec.redundancy))
+            {
+                const Expr& e = history[rnd.below(history.size())];
+                blk.code.emplace_back(dest() + " = " + e.a + " " + e.op + " " + e.b);
+            }
+            else if (rnd.chance(0.15))
+                blk.code.emplace_back(dest() + " = " + operand());
+            else
+            {
+                Expr e{ operand(), ops[rnd.below(5)], operand() };
+                blk.code.emplace_back(dest() + " = " + e.a + " " + e.op + " " + e.b);
+                history.emplace_back(std::move(e));
+            }
+        }
+
+        std::string label = "L" + std::to_string(rnd.below(16));
+        if (rnd.chance(spec.jumps))
+            blk.code.emplace_back("? " + operand() + " " + rops[rnd.below(6)] + " " + operand() + " : " + label);
+        else
+            blk.code.emplace_back("!: " + label);
+
+        size_t live = rnd.below(spec.liveOut + 1);
+        for (size_t k = 0; k < live; ++k)
+        {
+            std::string var = variable();
+            bool seen = false;
+            for (auto&& o : blk.out)
+                seen = seen || o == var;
+            if (!seen)
+                blk.out.emplace_back(var);
+        }
+        return blk;
+    }
+};
+
+// 以 count 个块或约 maxBytes 字节（先到者为准，0 表示不限）写出负载，返回写出的块数
+// 逐块写出，不在内存中保留整个文件
+size_t writeWorkload(std::ostream& os, const WorkloadSpec& spec, size_t count, uint64_t maxBytes = 0)
+{
+    WorkloadGenerator gen(spec);
+    uint64_t bytes = 0;
+    size_t written = 0;
+    std::string text;
+
+    auto strings = [&](const std::vector<std::string>& list)
+    {
+        if (list.empty())
+        {
+            text += "[]";
+            return;
+        }
+        text += "[\n";
+        for (size_t k = 0; k < list.size(); ++k)
+        {
+            text += "                \"" + list[k] + "\"";
+            text += k + 1 == list.size() ? "\n" : ",\n";
+        }
+        text += "            ]";
+    };
+
+    os << "{\n    \"blocks\": {";
+    while ((count == 0 || written < count) && (maxBytes == 0 || bytes < maxBytes))
+    {
+        SyntheticBlock blk = gen.next();
+        text.clear();
+        text += written == 0 ? "\n" : ",\n";
+        text += "        \"" + std::to_string(written) + "\": {\n            \"code\": ";
+        strings(blk.code);
+        text += ",\n            \"out\": ";
+        strings(blk.out);
+        text += "\n        }";
+
+        os << text;
+        bytes += text.size();
+        ++written;
+    }
+    os << "\n    },\n    \"summary\": {\n        \"total_blocks\": " << written << "\n    }\n}";
+    return written;
+}
+
+#endif